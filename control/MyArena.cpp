@@ -0,0 +1,135 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#include <new>
+
+/* local includes */
+#include "MyArena.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MyArena::MyArena(size_t chunkSize)
+	:
+	m_chunkSize(chunkSize),
+	m_current(NULL),
+	m_left(0),
+	m_liveBlocks(0),
+	m_liveBytes(0),
+	m_peakBytes(0),
+	m_freeBytes(0),
+	m_heapBlocks(0)
+{
+	for (size_t i = 0; i <= kClasses; i++) {
+		m_free[i] = NULL;
+	}
+}
+
+/**
+ *
+ */
+MyArena::~MyArena()
+{
+	for (auto chunk : m_chunks) {
+		::operator delete(chunk);
+	}
+
+	m_chunks.clear();
+}
+
+/**
+ *
+ */
+void* MyArena::allocate(size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t index = sizeClass(size ? size : 1);
+	size_t blockSize = index * kAlignment;
+	void* p = NULL;
+
+	if (size > kMaxBlock) {
+		m_heapBlocks++;
+		return ::operator new(size);
+	}
+
+	if (m_free[index]) {
+		/* recycle */
+		p = m_free[index];
+		m_free[index] = m_free[index]->next;
+		m_freeBytes -= blockSize;
+	}
+	else {
+		if (m_left < blockSize) {
+			/* the tail of the old chunk is lost, it's less than kMaxBlock */
+			m_current = static_cast<char*>(::operator new(m_chunkSize));
+			m_left = m_chunkSize;
+
+			m_chunks.push_back(m_current);
+		}
+
+		p = m_current;
+		m_current += blockSize;
+		m_left -= blockSize;
+	}
+
+	m_liveBlocks++;
+	m_liveBytes += blockSize;
+
+	if (m_liveBytes > m_peakBytes) {
+		m_peakBytes = m_liveBytes;
+	}
+
+	return p;
+}
+
+/**
+ *
+ */
+void MyArena::deallocate(void* p, size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t index = sizeClass(size ? size : 1);
+	size_t blockSize = index * kAlignment;
+
+	if (!p) {
+		return;
+	}
+
+	if (size > kMaxBlock) {
+		m_heapBlocks--;
+		::operator delete(p);
+		return;
+	}
+
+	FreeBlock* block = static_cast<FreeBlock*>(p);
+
+	block->next = m_free[index];
+	m_free[index] = block;
+
+	m_freeBytes += blockSize;
+	m_liveBlocks--;
+	m_liveBytes -= blockSize;
+}
+
+/**
+ *
+ */
+void MyArena::dumpStats(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t total = m_chunks.size() * m_chunkSize;
+
+	ML_LOG_DEBUG("%s arena chunks [%zu] bytes [%zu] live blocks [%zu] live bytes [%zu] peak [%zu] heap blocks [%zu]\n",
+				 name, m_chunks.size(), total, m_liveBlocks, m_liveBytes, m_peakBytes, m_heapBlocks);
+
+	ML_LOG_DEBUG("%s arena idle in free lists [%zu] fragmentation [%.1f%%]\n",
+				 name, m_freeBytes, total ? (100.0 * m_freeBytes / total) : 0.0);
+}
@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Playlist scoped memory arena. Memory is taken from large chunks
+ * and recycled through per size class free lists, so loading and
+ * clearing a playlist does not hit the heap for every item. Chunks
+ * are only released when the arena itself is destroyed.
+ */
+class MyArena
+{
+	public:
+		MyArena(size_t chunkSize = 64 * 1024);
+		~MyArena();
+
+		void* allocate(size_t size);
+		void deallocate(void* p, size_t size);
+
+		/**
+		 * Logs chunk usage and fragmentation (bytes idle in free lists).
+		 */
+		void dumpStats(const char* name);
+
+	private:
+		MyArena(const MyArena&);
+		MyArena& operator=(const MyArena&);
+
+		enum {
+			kAlignment = 16,		/* alignment and size class granularity		*/
+			kMaxBlock = 1024,		/* bigger requests are passed to the heap	*/
+			kClasses = kMaxBlock / kAlignment
+		};
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+
+		static size_t sizeClass(size_t size) { return (size + kAlignment - 1) / kAlignment; }
+
+		std::mutex m_mutex;
+		size_t m_chunkSize;
+		std::vector<char*> m_chunks;
+		char* m_current;			/* free space in the newest chunk			*/
+		size_t m_left;
+		FreeBlock* m_free[kClasses + 1];
+
+		size_t m_liveBlocks;
+		size_t m_liveBytes;
+		size_t m_peakBytes;
+		size_t m_freeBytes;
+		size_t m_heapBlocks;
+};
+
+/**
+ * STL allocator on top of MyArena, e.g. for std::allocate_shared.
+ */
+template <typename T>
+class MyArenaAllocator
+{
+	public:
+		typedef T value_type;
+
+		MyArenaAllocator(std::shared_ptr<MyArena> arena)
+			:
+			m_arena(arena)
+		{
+
+		}
+
+		template <typename U>
+		MyArenaAllocator(const MyArenaAllocator<U>& other)
+			:
+			m_arena(other.arena())
+		{
+
+		}
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(m_arena->allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+			m_arena->deallocate(p, n * sizeof(T));
+		}
+
+		const std::shared_ptr<MyArena>& arena() const { return m_arena; }
+
+	private:
+		std::shared_ptr<MyArena> m_arena; /* keeps the arena alive as long as objects use it */
+};
+
+template <typename T, typename U>
+inline bool operator==(const MyArenaAllocator<T>& a, const MyArenaAllocator<U>& b)
+{
+	return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const MyArenaAllocator<T>& a, const MyArenaAllocator<U>& b)
+{
+	return a.arena() != b.arena();
+}
@@ -0,0 +1,313 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#include <algorithm>
+#include <vector>
+
+/* local includes */
+#include "MyDidlCodec.h"
+
+#define DIDL_PACKED_MARKER		'\x01'	/* first byte of packed data		*/
+#define DIDL_PACKED_DICT		'\x02'	/* followed by dictionary index		*/
+#define DIDL_PACKED_LITERAL		'\x03'	/* followed by a literal byte		*/
+
+/**
+ * Hand-written dictionary of fragments common in the DIDL sent by
+ * Kinsky, Kazoo, BubbleUPnP, MinimServer, Twonky and Asset. At most
+ * 256 entries, the order does not matter as matching always picks
+ * the longest entry. The achieved ratio is not fixed, it is logged
+ * per installation by dumpMetadataStats().
+ */
+static const char* s_didlDictionary[] = {
+	"<DIDL-Lite xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\"",
+	"<DIDL-Lite xmlns:dc=\"http://purl.org/dc/elements/1.1/\"",
+	"<DIDL-Lite",
+	" xmlns=\"urn:schemas-upnp-org:metadata-1-0/DIDL-Lite/\"",
+	" xmlns:dc=\"http://purl.org/dc/elements/1.1/\"",
+	" xmlns:upnp=\"urn:schemas-upnp-org:metadata-1-0/upnp/\"",
+	" xmlns:dlna=\"urn:schemas-dlna-org:metadata-1-0/\"",
+	" xmlns:pv=\"http://www.pv.com/pvns/\"",
+	" xmlns:sec=\"http://www.sec.co.kr/\"",
+	" xmlns:arib=\"urn:schemas-arib-or-jp:elements-1-0/\"",
+	" xmlns:av=\"urn:schemas-sony-com:av\"",
+	"</DIDL-Lite>",
+	"<item id=\"",
+	"<item restricted=\"1\"",
+	"\" parentID=\"",
+	" restricted=\"1\"",
+	" restricted=\"0\"",
+	" refID=\"",
+	"</item>",
+	"<dc:title>",
+	"</dc:title>",
+	"<dc:creator>",
+	"</dc:creator>",
+	"<dc:date>",
+	"</dc:date>",
+	"<dc:description>",
+	"</dc:description>",
+	"<dc:publisher>",
+	"</dc:publisher>",
+	"<dc:contributor>",
+	"</dc:contributor>",
+	"<upnp:artist>",
+	"<upnp:artist role=\"AlbumArtist\">",
+	"<upnp:artist role=\"Performer\">",
+	"<upnp:artist role=\"Composer\">",
+	"</upnp:artist>",
+	"<upnp:author role=\"Composer\">",
+	"</upnp:author>",
+	"<upnp:album>",
+	"</upnp:album>",
+	"<upnp:genre>",
+	"</upnp:genre>",
+	"<upnp:albumArtURI",
+	"<upnp:albumArtURI>",
+	" dlna:profileID=\"JPEG_TN\"",
+	" dlna:profileID=\"JPEG_SM\"",
+	" dlna:profileID=\"PNG_TN\"",
+	"</upnp:albumArtURI>",
+	"<upnp:originalTrackNumber>",
+	"</upnp:originalTrackNumber>",
+	"<upnp:originalDiscNumber>",
+	"</upnp:originalDiscNumber>",
+	"<upnp:class>object.item.audioItem.musicTrack</upnp:class>",
+	"<upnp:class>object.item.audioItem.audioBroadcast</upnp:class>",
+	"<upnp:class>object.item.audioItem</upnp:class>",
+	"<upnp:class>",
+	"</upnp:class>",
+	"<upnp:icon>",
+	"</upnp:icon>",
+	"<upnp:rating>",
+	"</upnp:rating>",
+	"<upnp:playbackCount>",
+	"</upnp:playbackCount>",
+	"<desc id=\"",
+	" nameSpace=\"",
+	"</desc>",
+	"<res",
+	"</res>",
+	" protocolInfo=\"http-get:*:",
+	"audio/x-flac:",
+	"audio/flac:",
+	"audio/mpeg:",
+	"audio/x-wav:",
+	"audio/wav:",
+	"audio/L16;rate=44100;channels=2:",
+	"audio/mp4:",
+	"audio/x-m4a:",
+	"audio/x-aiff:",
+	"audio/x-ms-wma:",
+	"audio/ogg:",
+	"audio/aac:",
+	"DLNA.ORG_PN=MP3;",
+	"DLNA.ORG_PN=LPCM;",
+	"DLNA.ORG_PN=WMABASE;",
+	"DLNA.ORG_PN=AAC_ISO_320;",
+	"DLNA.ORG_OP=01;",
+	"DLNA.ORG_OP=00;",
+	"DLNA.ORG_CI=0;",
+	"DLNA.ORG_CI=1;",
+	"DLNA.ORG_FLAGS=01700000000000000000000000000000",
+	"DLNA.ORG_FLAGS=",
+	"00000000000000000000000000",
+	":*\"",
+	" duration=\"",
+	" size=\"",
+	" bitrate=\"",
+	" sampleFrequency=\"",
+	" bitsPerSample=\"",
+	" nrAudioChannels=\"2\"",
+	" nrAudioChannels=\"",
+	" protection=\"",
+	" importUri=\"",
+	" resolution=\"",
+	"\">http://",
+	"http://",
+	"https://",
+	"/MediaServer/",
+	"/MediaItems/",
+	"/minimserver/",
+	"/content/",
+	"/music/",
+	"/disk/",
+	"Various Artists",
+	"Unknown",
+	".flac",
+	".mp3",
+	".wav",
+	".m4a",
+	".jpg",
+	".png",
+	"&amp;",
+	"&lt;",
+	"&gt;",
+	"&quot;",
+	"&apos;",
+	"?size=",
+	":0:0:",
+	"00:0",
+	".000\"",
+	"\">",
+	"\"/>",
+};
+
+/**
+ * Dictionary lookup tables, built once on first use.
+ */
+class MyDidlDictionary
+{
+	public:
+		MyDidlDictionary()
+		{
+			size_t count = sizeof(s_didlDictionary) / sizeof(s_didlDictionary[0]);
+
+			for (size_t i = 0; (i < count) && (i < 256); i++) {
+				const char* entry = s_didlDictionary[i];
+
+				m_entries.push_back(std::string(entry));
+				m_buckets[(unsigned char)entry[0]].push_back((unsigned char)i);
+			}
+
+			/* longest match first */
+			for (int i = 0; i < 256; i++) {
+				std::sort(m_buckets[i].begin(), m_buckets[i].end(), [this](unsigned char a, unsigned char b) {
+					return m_entries[a].size() > m_entries[b].size();
+				});
+			}
+		}
+
+		/**
+		 * Returns the index of the longest entry matching at pos or -1.
+		 */
+		int match(const std::string& didl, size_t pos) const
+		{
+			const std::vector<unsigned char>& bucket = m_buckets[(unsigned char)didl[pos]];
+
+			for (auto index : bucket) {
+				const std::string& entry = m_entries[index];
+
+				/* a reference costs two bytes */
+				if (entry.size() < 3) {
+					break;
+				}
+
+				if (didl.compare(pos, entry.size(), entry) == 0) {
+					return index;
+				}
+			}
+
+			return -1;
+		}
+
+		const std::string& entry(unsigned char index) const { return m_entries[index]; }
+
+		size_t size() const { return m_entries.size(); }
+
+	private:
+		std::vector<std::string> m_entries;
+		std::vector<unsigned char> m_buckets[256];
+};
+
+static const MyDidlDictionary& dictionary()
+{
+	static MyDidlDictionary s_dictionary;
+
+	return s_dictionary;
+}
+
+/**
+ *
+ */
+bool MyDidlCodec::isPacked(const std::string& didl)
+{
+	return !didl.empty() && (didl[0] == DIDL_PACKED_MARKER);
+}
+
+/**
+ *
+ */
+void MyDidlCodec::pack(const std::string& didl, std::string& packed)
+{
+	const MyDidlDictionary& dict = dictionary();
+	size_t pos = 0;
+
+	packed.clear();
+	packed.reserve(didl.size() / 2 + 1);
+	packed += DIDL_PACKED_MARKER;
+
+	while (pos < didl.size()) {
+		int index = dict.match(didl, pos);
+
+		if (index != -1) {
+			packed += DIDL_PACKED_DICT;
+			packed += (char)index;
+			pos += dict.entry((unsigned char)index).size();
+		}
+		else {
+			char c = didl[pos++];
+
+			if ((c == DIDL_PACKED_MARKER) || (c == DIDL_PACKED_DICT) || (c == DIDL_PACKED_LITERAL)) {
+				/* not valid in XML, but keep it lossless */
+				packed += DIDL_PACKED_LITERAL;
+			}
+
+			packed += c;
+		}
+	}
+
+	/* release the over-reservation, we keep this string for a long time */
+	std::string(packed).swap(packed);
+}
+
+/**
+ *
+ */
+bool MyDidlCodec::unpack(const std::string& packed, std::string& didl)
+{
+	const MyDidlDictionary& dict = dictionary();
+	size_t pos = 1;
+
+	if (!isPacked(packed)) {
+		didl = packed;
+		return true;
+	}
+
+	didl.clear();
+	didl.reserve(packed.size() * 3);
+
+	while (pos < packed.size()) {
+		char c = packed[pos++];
+
+		if (c == DIDL_PACKED_DICT || c == DIDL_PACKED_LITERAL) {
+			if (pos >= packed.size()) {
+				return false;
+			}
+
+			if (c == DIDL_PACKED_DICT) {
+				unsigned char index = (unsigned char)packed[pos++];
+
+				if (index >= dict.size()) {
+					return false;
+				}
+
+				didl += dict.entry(index);
+			}
+			else {
+				didl += packed[pos++];
+			}
+		}
+		else {
+			didl += c;
+		}
+	}
+
+	return true;
+}
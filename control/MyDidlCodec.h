@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+/**
+ * Statistics of the in-memory DIDL compression.
+ */
+struct MyDidlStats
+{
+	MyDidlStats()
+		:
+		packs(0),
+		unpacks(0),
+		packIn(0),
+		packOut(0),
+		packMicros(0),
+		unpackMicros(0),
+		plainBytes(0),
+		packedBytes(0)
+	{
+
+	}
+
+	unsigned long packs;		/* number of pack operations					*/
+	unsigned long unpacks;		/* number of unpack operations (ReadList incl.)	*/
+	uint64_t packIn;			/* bytes fed into pack (cumulative)				*/
+	uint64_t packOut;			/* bytes produced by pack (cumulative)			*/
+	int64_t packMicros;			/* CPU time spent in pack						*/
+	int64_t unpackMicros;		/* CPU time spent in unpack						*/
+	size_t plainBytes;			/* plain meta data currently held				*/
+	size_t packedBytes;			/* packed meta data currently held				*/
+};
+
+/**
+ * Compresses DIDL-Lite meta data with a static dictionary of
+ * fragments typically found in DIDL (namespaces, tags, attributes,
+ * protocol info). Packed data starts with a control character
+ * which never appears in well formed XML, so packed and plain
+ * data can be kept in the same string.
+ */
+class MyDidlCodec
+{
+	public:
+		static bool isPacked(const std::string& didl);
+
+		static void pack(const std::string& didl, std::string& packed);
+		static bool unpack(const std::string& packed, std::string& didl);
+};
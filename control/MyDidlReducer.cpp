@@ -0,0 +1,153 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <PltDidl.h>
+#include <PltMediaItem.h>
+/* local includes */
+#include "MyDidlReducer.h"
+#include "MyLogger.h"
+
+/**
+ * Properties kept by the reducer, ToDidl() always adds id, parentID,
+ * restricted and upnp:class.
+ */
+#define DIDL_REDUCER_MASK	(PLT_FILTER_MASK_TITLE					| \
+							 PLT_FILTER_MASK_CREATOR				| \
+							 PLT_FILTER_MASK_ARTIST					| \
+							 PLT_FILTER_MASK_ALBUM					| \
+							 PLT_FILTER_MASK_ALBUMARTURI			| \
+							 PLT_FILTER_MASK_ORIGINALTRACK			| \
+							 PLT_FILTER_MASK_RES					| \
+							 PLT_FILTER_MASK_RES_DURATION			| \
+							 PLT_FILTER_MASK_RES_BITRATE			| \
+							 PLT_FILTER_MASK_RES_SAMPLEFREQUENCY	| \
+							 PLT_FILTER_MASK_RES_BITSPERSAMPLE		| \
+							 PLT_FILTER_MASK_RES_NRAUDIOCHANNELS	| \
+							 PLT_FILTER_MASK_RES_SIZE)
+
+/**
+ *
+ */
+MyDidlReducer::MyDidlReducer()
+	:
+	m_enabled(false),
+	m_reductions(0),
+	m_failures(0),
+	m_bytesIn(0),
+	m_bytesOut(0)
+{
+
+}
+
+/**
+ *
+ */
+void MyDidlReducer::setEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+/**
+ *
+ */
+void MyDidlReducer::setResourcePolicy(MyResourcePolicyPtr policy)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_policy = policy;
+
+	/* the cached DIDL may have another resource now */
+	m_lastDidl.clear();
+}
+
+/**
+ *
+ */
+NPT_String MyDidlReducer::reduce(const std::string& didl)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	NPT_String reduced;
+
+	if (!m_enabled || didl.empty()) {
+		return didl.c_str();
+	}
+
+	if (didl == m_lastDidl) {
+		return m_lastReduced;
+	}
+
+	if (minimize(didl.c_str(), m_policy.get(), reduced) && (reduced.GetLength() < didl.size())) {
+		m_reductions++;
+		m_bytesIn += didl.size();
+		m_bytesOut += reduced.GetLength();
+	}
+	else {
+		/* nothing to win, event as is */
+		m_failures++;
+		reduced = didl.c_str();
+	}
+
+	m_lastDidl = didl;
+	m_lastReduced = reduced;
+
+	return reduced;
+}
+
+/**
+ *
+ */
+void MyDidlReducer::dump(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ML_LOG_DEBUG("%s evented meta data reduced [%lu] kept [%lu], bytes [%llu] -> [%llu]\n", name,
+				 m_reductions, m_failures, (unsigned long long)m_bytesIn, (unsigned long long)m_bytesOut);
+}
+
+/**
+ * Keeps the first object with its best resource only, selected the
+ * same way as for create_metadata_from_media_object().
+ */
+bool MyDidlReducer::minimize(const char* didl, const MyResourcePolicy* policy, NPT_String& reduced)
+{
+	PLT_MediaObjectListReference list;
+	PLT_MediaObject* object = NULL;
+
+	if (NPT_FAILED(PLT_Didl::FromDidl(didl, list))) {
+		return false;
+	}
+
+	list->Get(0, object);
+
+	if (!object) {
+		return false;
+	}
+
+	MyProtocolInfo::sink().selectResources(object, policy);
+
+	if (object->m_Resources.GetItemCount() > 1) {
+		PLT_MediaItemResource resource = object->m_Resources[0];
+
+		object->m_Resources.Clear();
+		object->m_Resources.Add(resource);
+	}
+
+	reduced = didl_header;
+
+	if (NPT_FAILED(object->ToDidl(DIDL_REDUCER_MASK, reduced))) {
+		return false;
+	}
+
+	reduced += didl_footer;
+
+	return true;
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+/* local includes */
+#include <MyProtocolInfo.h>
+
+/**
+ * Reduces DIDL-Lite meta data to a canonical minimal form (title,
+ * artist, album, album art and the resource played) before it's
+ * evented (OH Info Metadata, AVTransport CurrentTrackMetadata).
+ * The original DIDL is kept for ReadList and friends.
+ */
+class MyDidlReducer
+{
+	public:
+		MyDidlReducer();
+
+		/**
+		 * Off by default, evented meta data is passed on unchanged.
+		 */
+		void setEnabled(bool enabled);
+
+		/**
+		 * Resource selection used for the reduced DIDL, NULL for none.
+		 */
+		void setResourcePolicy(MyResourcePolicyPtr policy);
+
+		/**
+		 * Meta data to event for didl. If disabled or if didl can't be
+		 * parsed, didl itself is returned.
+		 */
+		NPT_String reduce(const std::string& didl);
+
+		void dump(const char* name);
+
+	private:
+		static bool minimize(const char* didl, const MyResourcePolicy* policy, NPT_String& reduced);
+
+	private:
+		std::mutex m_mutex;
+		std::atomic<bool> m_enabled;
+		MyResourcePolicyPtr m_policy;
+		std::string m_lastDidl;		/* one entry cache, state updates re-send the same track */
+		NPT_String m_lastReduced;
+		unsigned long m_reductions;
+		unsigned long m_failures;
+		uint64_t m_bytesIn;
+		uint64_t m_bytesOut;
+};
@@ -0,0 +1,529 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <strings.h>
+#include <chrono>
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+/* local includes */
+#include "MyDurationProber.h"
+#include "MyLogger.h"
+
+#define DURATION_PROBE_BYTES		(64*1024)	/* header bytes read per track			*/
+#define DURATION_PROBE_TIMEOUT		5000		/* ms, connect and I/O					*/
+#define DURATION_CACHE_SIZE			1024		/* URIs remembered						*/
+#define DURATION_PROBE_RETRY		60			/* s, a failed URI isn't probed again before	*/
+
+/**
+ *
+ */
+static uint32_t read_be32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ *
+ */
+static uint32_t read_le32(const uint8_t* p)
+{
+	return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+/**
+ * FLAC, STREAMINFO is always the first meta data block.
+ */
+static int parse_flac(const uint8_t* data, size_t size)
+{
+	if ((size < 8 + 18) || (memcmp(data, "fLaC", 4) != 0) || ((data[4] & 0x7F) != 0)) {
+		return -1;
+	}
+
+	const uint8_t* p = data + 8 + 10;
+	uint32_t sampleRate = ((uint32_t)p[0] << 12) | ((uint32_t)p[1] << 4) | (p[2] >> 4);
+	uint64_t samples = ((uint64_t)(p[3] & 0x0F) << 32) | read_be32(p + 4);
+
+	if (!sampleRate || !samples) {
+		return -1;
+	}
+
+	return (int)((samples + sampleRate / 2) / sampleRate);
+}
+
+/**
+ * WAV, walks the chunks up to "data".
+ */
+static int parse_wav(const uint8_t* data, size_t size, uint64_t totalSize)
+{
+	uint32_t byteRate = 0;
+	size_t offset = 12;
+
+	if ((size < 12) || (memcmp(data, "RIFF", 4) != 0) || (memcmp(data + 8, "WAVE", 4) != 0)) {
+		return -1;
+	}
+
+	while (offset + 8 <= size) {
+		const uint8_t* chunk = data + offset;
+		uint32_t chunkSize = read_le32(chunk + 4);
+
+		if ((memcmp(chunk, "fmt ", 4) == 0) && (offset + 8 + 12 <= size)) {
+			byteRate = read_le32(chunk + 8 + 8);
+		}
+		else if (memcmp(chunk, "data", 4) == 0) {
+			uint64_t dataSize = chunkSize;
+
+			/* streamed WAV has no valid size, take the rest of the file */
+			if (((chunkSize == 0) || (chunkSize == 0xFFFFFFFF)) && totalSize > offset + 8) {
+				dataSize = totalSize - offset - 8;
+			}
+
+			if (!byteRate || !dataSize) {
+				return -1;
+			}
+
+			return (int)((dataSize + byteRate / 2) / byteRate);
+		}
+
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+
+	return -1;
+}
+
+/**
+ * Size of the ID3v2 tag at the start of data including header and
+ * footer, 0 if there is none. The size is sync safe.
+ */
+static size_t id3v2_size(const uint8_t* data, size_t size)
+{
+	if ((size < 10) || (memcmp(data, "ID3", 3) != 0)) {
+		return 0;
+	}
+
+	return 10 + ((data[5] & 0x10) ? 10 : 0) +
+		(((size_t)(data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) | ((data[8] & 0x7F) << 7) | (data[9] & 0x7F));
+}
+
+/**
+ * MPEG audio layer III frame header at h, false if it isn't one.
+ */
+struct Mp3Header
+{
+	bool mpeg1;
+	bool mono;
+	int sampleRate;
+	int bitrate;		/* bit/s */
+	size_t frameSize;	/* bytes incl. header */
+};
+
+static bool parse_mp3_header(const uint8_t* h, Mp3Header& header)
+{
+	static const int bitrates[2][16] = {
+		{ 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },	/* MPEG 1			*/
+		{ 0,  8, 16, 24, 32, 40, 48, 56,  64,  80,  96, 112, 128, 144, 160, 0 },	/* MPEG 2 and 2.5	*/
+	};
+	static const int sampleRates[3] = { 44100, 48000, 32000 };
+
+	if ((h[0] != 0xFF) || ((h[1] & 0xE0) != 0xE0)) {
+		return false;
+	}
+
+	int version = (h[1] >> 3) & 0x03;		/* 3 = MPEG 1, 2 = MPEG 2, 0 = MPEG 2.5 */
+	int layer = (h[1] >> 1) & 0x03;			/* 1 = layer III */
+	int bitrateIndex = h[2] >> 4;
+	int sampleRateIndex = (h[2] >> 2) & 0x03;
+
+	if ((version == 1) || (layer != 1) || !bitrates[0][bitrateIndex] || (sampleRateIndex == 3)) {
+		return false;
+	}
+
+	header.mpeg1 = (version == 3);
+	header.mono = ((h[3] >> 6) & 0x03) == 0x03;
+	header.sampleRate = sampleRates[sampleRateIndex] >> (header.mpeg1 ? 0 : ((version == 2) ? 1 : 2));
+	header.bitrate = bitrates[header.mpeg1 ? 0 : 1][bitrateIndex] * 1000;
+	header.frameSize = (header.mpeg1 ? 144 : 72) * header.bitrate / header.sampleRate + ((h[2] >> 1) & 0x01);
+
+	return true;
+}
+
+/**
+ * MP3 (MPEG audio layer III), Xing/Info or VBRI frame count if
+ * present, otherwise estimated from the bitrate of the first frame.
+ * A frame only counts if the next one follows right after it with
+ * the same sample rate, random 0xFFE bytes in a cover picture or a
+ * non MPEG file are not taken for a header. data starts at byte
+ * base of the file, the ID3v2 tag is skipped if base is 0.
+ */
+static int parse_mp3(const uint8_t* data, size_t size, uint64_t totalSize, uint64_t base)
+{
+	size_t offset = base ? 0 : id3v2_size(data, size);
+
+	for (; offset + 4 <= size; offset++) {
+		const uint8_t* h = data + offset;
+		Mp3Header header;
+		Mp3Header next;
+
+		if (!parse_mp3_header(h, header)) {
+			continue;
+		}
+
+		if ((offset + header.frameSize + 4 > size) ||
+			!parse_mp3_header(h + header.frameSize, next) ||
+			(next.sampleRate != header.sampleRate) || (next.mpeg1 != header.mpeg1)) {
+			continue;
+		}
+
+		int samplesPerFrame = header.mpeg1 ? 1152 : 576;
+		size_t sideInfo = header.mpeg1 ? (header.mono ? 17 : 32) : (header.mono ? 9 : 17);
+		const uint8_t* xing = h + 4 + sideInfo;
+		const uint8_t* vbri = h + 4 + 32;
+		uint32_t frames = 0;
+
+		if ((xing + 12 <= data + size) && ((memcmp(xing, "Xing", 4) == 0) || (memcmp(xing, "Info", 4) == 0)) && (read_be32(xing + 4) & 0x01)) {
+			frames = read_be32(xing + 8);
+		}
+		else if ((vbri + 18 <= data + size) && (memcmp(vbri, "VBRI", 4) == 0)) {
+			frames = read_be32(vbri + 14);
+		}
+
+		if (frames) {
+			return (int)(((uint64_t)frames * samplesPerFrame + header.sampleRate / 2) / header.sampleRate);
+		}
+
+		/* CBR estimate, needs the file size */
+		if (!totalSize || (totalSize <= base + offset)) {
+			return -1;
+		}
+
+		return (int)((totalSize - base - offset) * 8 / header.bitrate);
+	}
+
+	return -1;
+}
+
+/**
+ * MP3 has no magic, only tried if the server or the URI says so.
+ */
+static bool is_mp3(const std::string& uri, const NPT_String& contentType)
+{
+	NPT_String mime = contentType;
+	std::string path = uri.substr(0, uri.find('?'));
+
+	mime.MakeLowercase();
+
+	if (mime.StartsWith("audio/mpeg") || mime.StartsWith("audio/mp3") || mime.StartsWith("audio/x-mpeg")) {
+		return true;
+	}
+
+	return (path.size() >= 4) && (strcasecmp(path.c_str() + path.size() - 4, ".mp3") == 0);
+}
+
+/**
+ *
+ */
+MyDurationProber& MyDurationProber::instance()
+{
+	static MyDurationProber s_prober;
+
+	return s_prober;
+}
+
+/**
+ *
+ */
+MyDurationProber::MyDurationProber()
+	:
+	m_probes(0),
+	m_failures(0),
+	m_micros(0),
+	m_stop(false),
+	m_thread(&MyDurationProber::run, this)
+{
+
+}
+
+/**
+ *
+ */
+MyDurationProber::~MyDurationProber()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_cond.notify_one();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+/**
+ *
+ */
+void MyDurationProber::probe(const std::string& uri)
+{
+	if (uri.empty()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto failed = m_failed.find(uri);
+
+		if (m_cache.count(uri) ||
+			((failed != m_failed.end()) && (std::chrono::steady_clock::now() - failed->second < std::chrono::seconds(DURATION_PROBE_RETRY)))) {
+			return;
+		}
+
+		if (!m_queued.insert(uri).second) {
+			return;
+		}
+
+		m_queue.push_back(uri);
+	}
+
+	m_cond.notify_one();
+}
+
+/**
+ *
+ */
+bool MyDurationProber::lookup(const std::string& uri, int& seconds)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_cache.find(uri);
+
+	if (it == m_cache.end()) {
+		return false;
+	}
+
+	seconds = it->second;
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyDurationProber::dump()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ML_LOG_DEBUG("duration probes [%lu] failed [%lu] avg [%.1f ms], cached [%zu] queued [%zu]\n",
+				 m_probes, m_failures, m_probes ? (double)m_micros / m_probes / 1000 : 0.0,
+				 m_cache.size(), m_queue.size());
+}
+
+/**
+ *
+ */
+int MyDurationProber::parse(const uint8_t* data, size_t size, uint64_t totalSize, bool mp3)
+{
+	int seconds;
+
+	if ((seconds = parse_flac(data, size)) >= 0) {
+		return seconds;
+	}
+
+	if ((seconds = parse_wav(data, size, totalSize)) >= 0) {
+		return seconds;
+	}
+
+	return mp3 ? parse_mp3(data, size, totalSize, 0) : -1;
+}
+
+/**
+ * Reads up to DURATION_PROBE_BYTES of uri starting at byte from.
+ * totalSize is the size of the file if the server tells, 0 if not.
+ */
+static bool fetch_range(const std::string& uri, uint64_t from, std::vector<uint8_t>& buffer, size_t& size,
+						uint64_t& totalSize, NPT_String& contentType)
+{
+	NPT_HttpClient client;
+	NPT_HttpRequest request(uri.c_str(), NPT_HTTP_METHOD_GET, NPT_HTTP_PROTOCOL_1_1);
+	NPT_HttpResponse* response = NULL;
+	NPT_InputStreamReference stream;
+	bool result = false;
+
+	buffer.resize(DURATION_PROBE_BYTES);
+	size = 0;
+	totalSize = 0;
+
+	if (!request.GetUrl().IsValid()) {
+		return false;
+	}
+
+	client.SetTimeouts(DURATION_PROBE_TIMEOUT, DURATION_PROBE_TIMEOUT, DURATION_PROBE_TIMEOUT);
+
+	request.GetHeaders().SetHeader(NPT_HTTP_HEADER_RANGE, NPT_String("bytes=") + NPT_String::FromIntegerU(from) + "-" +
+								   NPT_String::FromIntegerU(from + DURATION_PROBE_BYTES - 1));
+
+	if (NPT_FAILED(client.SendRequest(request, response)) || !response) {
+		return false;
+	}
+
+	/* a server ignoring the range sends the file from the start, only fine for the first read */
+	if (((response->GetStatusCode() == 206) || ((response->GetStatusCode() == 200) && (from == 0))) && response->GetEntity() &&
+		NPT_SUCCEEDED(response->GetEntity()->GetInputStream(stream)) && !stream.IsNull()) {
+		const NPT_String* contentRange = response->GetHeaders().GetHeaderValue("Content-Range");
+		NPT_Int64 total = 0;
+
+		/* "bytes 0-65535/123456", or the whole file if the server ignores the range */
+		if (contentRange && (contentRange->Find('/') >= 0) &&
+			NPT_SUCCEEDED(contentRange->SubString(contentRange->Find('/') + 1).ToInteger64(total))) {
+			totalSize = total;
+		}
+		else if (response->GetStatusCode() == 200) {
+			totalSize = response->GetEntity()->GetContentLength();
+		}
+
+		contentType = response->GetEntity()->GetContentType();
+
+		while (size < buffer.size()) {
+			NPT_Size read = 0;
+
+			if (NPT_FAILED(stream->Read(&buffer[size], buffer.size() - size, &read)) || !read) {
+				break;
+			}
+
+			size += read;
+		}
+
+		result = true;
+	}
+
+	delete response;
+
+	return result;
+}
+
+/**
+ * Reads the first DURATION_PROBE_BYTES of uri and parses them. An MP3
+ * with an ID3v2 tag larger than that (cover art) needs a second read
+ * after the tag.
+ */
+int MyDurationProber::fetch(const std::string& uri)
+{
+	std::vector<uint8_t> buffer;
+	NPT_String contentType;
+	uint64_t totalSize = 0;
+	size_t size = 0;
+	int seconds = -1;
+
+	if (!fetch_range(uri, 0, buffer, size, totalSize, contentType)) {
+		return -1;
+	}
+
+	bool mp3 = is_mp3(uri, contentType);
+
+	seconds = parse(&buffer[0], size, totalSize, mp3);
+
+	size_t tagSize = mp3 ? id3v2_size(&buffer[0], size) : 0;
+
+	if ((seconds < 0) && (tagSize >= size) && (!totalSize || (tagSize < totalSize))) {
+		uint64_t tagEnd = tagSize;
+
+		ML_LOG_DEBUG("ID3v2 tag of [%zu] bytes, second read for %s\n", tagSize, uri.c_str());
+
+		if (fetch_range(uri, tagEnd, buffer, size, totalSize, contentType)) {
+			seconds = parse_mp3(&buffer[0], size, totalSize, tagEnd);
+		}
+	}
+
+	return seconds;
+}
+
+/**
+ * Forgets failures past their back-off. Lock must be held.
+ */
+void MyDurationProber::expireFailures()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	for (auto it = m_failed.begin(); it != m_failed.end();) {
+		if (now - it->second >= std::chrono::seconds(DURATION_PROBE_RETRY)) {
+			it = m_failed.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+/**
+ *
+ */
+void MyDurationProber::run()
+{
+#if defined(__linux__)
+	/* only use otherwise idle CPU time */
+	struct sched_param param;
+	param.sched_priority = 0;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+		if (m_stop) {
+			break;
+		}
+
+		std::string uri = m_queue.front();
+		m_queue.pop_front();
+
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		int seconds = fetch(uri);
+		int64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+		ML_LOG_DEBUG("probed duration of %s [%d] s in [%lld] us\n", uri.c_str(), seconds, (long long)micros);
+
+		lock.lock();
+
+		m_queued.erase(uri);
+
+		/* failures may be transient (busy server, timeout), they only back off */
+		if (seconds <= 0) {
+			expireFailures();
+			m_failed[uri] = std::chrono::steady_clock::now();
+		}
+		else {
+			m_failed.erase(uri);
+
+			if (m_cache.insert(std::make_pair(uri, seconds)).second) {
+				m_cacheOrder.push_back(uri);
+			}
+		}
+
+		while (m_cacheOrder.size() > DURATION_CACHE_SIZE) {
+			m_cache.erase(m_cacheOrder.front());
+			m_cacheOrder.pop_front();
+		}
+
+		m_probes++;
+		m_micros += micros;
+
+		if (seconds <= 0) {
+			m_failures++;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+#define DURATION_PROBE_AHEAD		3	/* tracks after the current one probed */
+
+/**
+ * Determines the duration of tracks whose meta data has none, on a
+ * low priority thread, by reading the container header with a HTTP
+ * range request (FLAC STREAMINFO, WAV fmt/data, MP3 Xing/VBRI or
+ * CBR estimate). Results are cached by URI, failures are retried
+ * after a back-off.
+ */
+class MyDurationProber
+{
+	public:
+		static MyDurationProber& instance();
+
+		/**
+		 * Queues uri unless it's known or already queued.
+		 */
+		void probe(const std::string& uri);
+
+		/**
+		 * True if a duration (seconds) was found for uri.
+		 */
+		bool lookup(const std::string& uri, int& seconds);
+
+		void dump();
+
+		/**
+		 * Duration (seconds) from the first bytes of a file of totalSize
+		 * bytes (0 if unknown), -1 if the format isn't recognized. MP3
+		 * has no magic and is only tried if mp3 (by mime or extension).
+		 */
+		static int parse(const uint8_t* data, size_t size, uint64_t totalSize, bool mp3);
+
+	private:
+		MyDurationProber();
+		~MyDurationProber();
+
+		MyDurationProber(const MyDurationProber&);
+		MyDurationProber& operator=(const MyDurationProber&);
+
+		void run();
+		void expireFailures();
+		static int fetch(const std::string& uri);
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<std::string> m_queue;
+		std::set<std::string> m_queued;
+		std::map<std::string, int> m_cache;		/* uri -> seconds, successes only */
+		std::map<std::string, std::chrono::steady_clock::time_point> m_failed;	/* uri -> last failure */
+		std::deque<std::string> m_cacheOrder;	/* oldest first, bounds the cache */
+		unsigned long m_probes;
+		unsigned long m_failures;
+		int64_t m_micros;
+		bool m_stop;
+		std::thread m_thread;
+};
@@ -11,6 +11,11 @@
 
 #include <assert.h>
 #include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 /* Platinum/Neptune UPnP SDK includes */
 #include <PltService.h>
 #include <PltUtilities.h>
@@ -21,9 +26,23 @@
 #include "Renderer.h"
 #include "MyLogger.h"
 #include "MyMessages.h"
+#include "MyParallel.h"
+#include "MyScheduler.h"
+#include "MyTrackCache.h"
 
 NPT_SET_LOCAL_LOGGER("platinum.oh.myplaylist")
 
+#define PLAYLIST_EXT_SERVICE_TYPE	"urn:albistechnologies-com:service:PlaylistExt:1"
+#define PLAYLIST_EXT_SERVICE_ID		"urn:albistechnologies-com:serviceId:PlaylistExt"
+#define PLAYLIST_DEFAULT_TRACKS_MAX		0			/* unlimited unless configured	*/
+#define PLAYLIST_DEFAULT_BYTES_MAX		0
+
+#define PLAYLIST_EXT_MAX_PAGE_ENTRIES	500			/* ReadRange entries per page		*/
+#define PLAYLIST_EXT_MAX_PAGE_BYTES		(512*1024)	/* ReadRange TrackList size per page	*/
+#define PLAYLIST_EXT_MAX_METADATA	(256 * 1024)
+
+extern NPT_UInt8 MY_PlaylistExtSCPD[];
+
 /**
  *
  */
@@ -38,10 +57,42 @@ MyOHPlaylist::MyOHPlaylist(std::shared_ptr<IRenderer> renderer, void* ctx,const
 	m_id(0),
 	m_trackCount(0),
 	m_token(1),
-	m_idArray("")
+	m_idArray(""),
+	m_metadataBudget(0),
+	m_tracksMax(PLAYLIST_DEFAULT_TRACKS_MAX),
+	m_bytesMax(PLAYLIST_DEFAULT_BYTES_MAX),
+	m_itemBytes(0),
+	m_dedupMode(DedupMode::Off),
+	m_uriIndexBytes(0),
+	m_duplicatesRejected(0),
+	m_duplicatesCollapsed(0),
+	m_duplicatesCompacted(0),
+	m_parserThreads(my_parallel_default_threads()),
+	m_infoDirty(true),
+	m_timeDirty(true),
+	m_lazyComputed(0),
+	m_lazySkipped(0),
+	m_lazyMicros(0),
+	m_idArrayReads(0),
+	m_idArrayChangedCalls(0),
+	m_idArrayUnchanged(0),
+	m_settlePending(false),
+	m_settlePaused(false),
+	m_skips(0),
+	m_skipPlays(0),
+	m_snapshotDirty(false),
+	m_snapshotPublishes(0),
+	m_snapshotReads(0),
+	m_snapshotFallbacks(0)
 {
 	ML_ENTRY_EXIT();
 
+	/* token 1 is the empty playlist */
+	m_tokenHistory.fill(TokenHistoryEntry());
+	m_tokenHistory[m_token % ID_ARRAY_TOKEN_HISTORY] = TokenHistoryEntry(m_token, "");
+
+	publishSnapshot();
+
 	m_renderer->registerNotifier(this);
 }
 
@@ -52,21 +103,14 @@ MyOHPlaylist::~MyOHPlaylist()
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	cancelDeferred();
 
-/* this are equale functions */
-#if 0
-	for (auto i : m_mediaItems) {
-		i.reset();
-	}
-#else
-	std::for_each(m_mediaItems.begin(), m_mediaItems.end(), [](std::shared_ptr<MediaItem> n){ n.reset();});
-#endif
+	MY_LOCK_GUARD(lock, m_mutex);
 
 	m_mediaItems.clear();
 
 	m_index = -1;
-	m_testTime = 0;
+	m_clock.reset();
 
 	m_renderer.reset();
 }
@@ -81,6 +125,21 @@ void MyOHPlaylist::UpdateState()
 	/* UpdateState() will be called only by this class. So no lock required, because it's already held by the caller */
 
 	PLT_Service* service = NULL;
+	RendererState state = m_rendererStatus.refreshState();
+
+	/* paused in the settle window, the renderer is stopped but the target waits for Play */
+	if (m_settlePaused) {
+		state = RendererState::Paused;
+	}
+
+	m_clock.setRunning(state == RendererState::Playing);
+
+	/* we do not get always the duration from metadata (KAZOO issue), probe the upcoming tracks */
+	if (m_index != -1) {
+		for (size_t i = m_index; (i < m_mediaItems.size()) && (i <= (size_t)m_index + DURATION_PROBE_AHEAD); i++) {
+			probeDuration(m_mediaItems[i]);
+		}
+	}
 
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", service))) {
 		service->PauseEventing(true);
@@ -97,7 +156,7 @@ void MyOHPlaylist::UpdateState()
 
 		service->SetStateVariable("IdArrayToken", NPT_String::FromInteger(m_token));
 
-		switch (m_renderer->getState()) {
+		switch (state) {
 			case RendererState::Stopped:
 				service->SetStateVariable("TransportState", "Stopped");
 				break;
@@ -117,21 +176,51 @@ void MyOHPlaylist::UpdateState()
 		service->PauseEventing(false);
 	}
 
+	/* Info and Time are only computed if somebody listens */
+	if (m_subscriptions.hasSubscribers("urn:av-openhome-org:service:Info:1")) {
+		UpdateInfoState();
+	}
+	else {
+		m_infoDirty = true;
+		m_lazySkipped++;
+	}
+
+	if (m_subscriptions.hasSubscribers("urn:av-openhome-org:service:Time:1")) {
+		UpdateTimeState();
+	}
+	else {
+		m_timeDirty = true;
+		m_lazySkipped++;
+	}
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::UpdateInfoState()
+{
+	ML_ENTRY_EXIT();
+
+	PLT_Service* service = NULL;
+	auto start = std::chrono::steady_clock::now();
+
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Info:1", service))) {
 		service->PauseEventing(true);
 
 		if (m_index != -1) {
-			service->SetStateVariable("Uri", m_mediaItems[m_index]->ohPltURI.c_str());
-			service->SetStateVariable("Metadata", m_mediaItems[m_index]->ohPltMetadata.c_str());
+			std::shared_ptr<MediaItem> item = currentItem();
+
+			service->SetStateVariable("Uri", item->ohPltURI.c_str());
+			service->SetStateVariable("Metadata", m_didlReducer.reduce(item->ohPltMetadata));
 
 			/* KAZOO issue (stop icon instead pause on start), only set duration here if valid */
-			if (m_mediaItems[m_index]->duration != 0) {
-				service->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
+			if (item->duration != 0) {
+				service->SetStateVariable("Duration", NPT_String::FromInteger(item->duration));
 			}
 
 			service->SetStateVariable("TrackCount", NPT_String::FromInteger(m_trackCount));
 
-			std::shared_ptr<MetaData> metaData = m_mediaItems[m_index]->getMetaData();
+			std::shared_ptr<MetaData> metaData = item->getMetaData();
 
 			if (metaData && metaData->resources.size()) {
 				/* taking always the first entry */
@@ -167,6 +256,21 @@ void MyOHPlaylist::UpdateState()
 		service->PauseEventing(false);
 	}
 
+	m_infoDirty = false;
+	m_lazyComputed++;
+	m_lazyMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::UpdateTimeState()
+{
+	ML_ENTRY_EXIT();
+
+	PLT_Service* service = NULL;
+	auto start = std::chrono::steady_clock::now();
+
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Time:1", service))) {
 		service->PauseEventing(true);
 
@@ -178,7 +282,7 @@ void MyOHPlaylist::UpdateState()
 				service->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
 			}
 
-			service->SetStateVariable("Seconds", NPT_String::FromInteger(m_testTime));
+			service->SetStateVariable("Seconds", NPT_String::FromInteger(m_clock.seconds()));
 		}
 		else {
 			service->SetStateVariable("Duration", "");
@@ -188,6 +292,160 @@ void MyOHPlaylist::UpdateState()
 		service->PauseEventing(false);
 	}
 
+	m_timeDirty = false;
+	m_lazyComputed++;
+	m_lazyMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Computes deferred state of a service before it's read by
+ * a new subscriber or a query action. Lock must be held.
+ */
+void MyOHPlaylist::RefreshLazyState(const NPT_String& serviceType)
+{
+	if (m_infoDirty && (serviceType.Compare("urn:av-openhome-org:service:Info:1") == 0)) {
+		UpdateInfoState();
+	}
+
+	if (m_timeDirty && (serviceType.Compare("urn:av-openhome-org:service:Time:1") == 0)) {
+		UpdateTimeState();
+	}
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::dumpStateStats()
+{
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	ML_LOG_DEBUG("Info/Time state computed [%lu] avg [%.1f us], deferred [%lu]\n",
+				 m_lazyComputed, m_lazyComputed ? (double)m_lazyMicros / m_lazyComputed : 0.0, m_lazySkipped);
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::dumpSkipStats()
+{
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	ML_LOG_DEBUG("skips [%lu] tracks started after settling [%lu]\n", m_skips, m_skipPlays);
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::dumpSnapshotStats()
+{
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	ML_LOG_DEBUG("snapshots published [%lu], lock free reads [%lu] with fallback to the lock [%lu]\n",
+				 m_snapshotPublishes, m_snapshotReads.load(), m_snapshotFallbacks.load());
+}
+
+/**
+ * Publishes the playlist for the query actions. With quiesce it waits
+ * until no reader holds the previous one anymore (grace period). Only
+ * readers of a stable snapshot need waiting for, they never take the
+ * lock. Readers of an unstable one drop it and read under the lock, so
+ * the wait is skipped for those. Each publish copies the whole item
+ * vector (O(N)), so changes only mark it dirty and the copy is made by
+ * the next reader, see currentSnapshot(). Lock must be held.
+ */
+void MyOHPlaylist::publishSnapshot(bool quiesce)
+{
+	std::shared_ptr<PlaylistSnapshot> snapshot = std::make_shared<PlaylistSnapshot>();
+
+	snapshot->token = m_token;
+	snapshot->idArray = m_idArray;
+	snapshot->items = m_mediaItems;
+	snapshot->metadataStable = (m_metadataBudget == 0) && (m_didlStats.packedBytes == 0);
+
+	std::shared_ptr<PlaylistSnapshot> previous = std::atomic_exchange(&m_snapshot, snapshot);
+
+	m_snapshotDirty = false;
+	m_snapshotPublishes++;
+
+	if (!previous) {
+		return;
+	}
+
+	while (quiesce && previous->metadataStable && (previous.use_count() > 1)) {
+		std::this_thread::yield();
+	}
+
+	/* dropped items are released by the reclaimer, unless a reader still has them */
+	if (previous.use_count() == 1) {
+		MyReclaimer::instance().reclaim(previous->items);
+	}
+}
+
+/**
+ * Snapshot for the query actions, published first if the playlist
+ * changed since. A run of single inserts (Kazoo) thus costs one copy
+ * when it is read, not one per insert.
+ */
+std::shared_ptr<MyOHPlaylist::PlaylistSnapshot> MyOHPlaylist::currentSnapshot()
+{
+	if (m_snapshotDirty) {
+		MY_LOCK_GUARD(lock, m_mutex);
+
+		if (m_snapshotDirty) {
+			publishSnapshot();
+		}
+	}
+
+	return std::atomic_load(&m_snapshot);
+}
+
+/**
+ * Starts the current track once no further skip came in for PLAY_SETTLE,
+ * the model and the events are updated by the caller right away. Lock
+ * must be held.
+ */
+void MyOHPlaylist::settlePlay()
+{
+	m_skips++;
+	m_settlePending = true;
+	m_settlePaused = false;
+
+	/* the base cancels the slots of IMyPLTController* in cancelDeferred() */
+	MyScheduler::instance().schedule(static_cast<IMyPLTController*>(this), PLAY_SETTLE_SLOT, std::chrono::milliseconds(PLAY_SETTLE), [this] {
+		MY_LOCK_GUARD(lock, m_mutex);
+
+		/* cancelled while we waited for the lock */
+		if (!m_settlePending) {
+			return;
+		}
+
+		m_settlePending = false;
+
+		if (m_index != -1) {
+			m_skipPlays++;
+
+			std::shared_ptr<MediaItem> item = currentItem();
+			m_renderer->play(this, cachedItem(item));
+			m_clock.reset();
+
+			UpdateState();
+		}
+	});
+}
+
+/**
+ * Drops a pending settlePlay() or a target paused before it started,
+ * true if there was one. Lock must be held.
+ */
+bool MyOHPlaylist::cancelSettle()
+{
+	bool pending = m_settlePending || m_settlePaused;
+
+	m_settlePending = false;
+	m_settlePaused = false;
+	MyScheduler::instance().cancel(static_cast<IMyPLTController*>(this), PLAY_SETTLE_SLOT);
+
+	return pending;
 }
 
 /**
@@ -201,14 +459,23 @@ NPT_Result MyOHPlaylist::SetupServices()
 
     NPT_CHECK(PLT_OHPlaylist::SetupServices());
 
+    /* later updated by RendererChanges() */
+    m_rendererStatus.refresh();
+
     if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", service))) {
 		/* pause automatic eventing, we change multiple state vars */
     	service->PauseEventing(true);
 
     	service->SetStateVariable("ProtocolInfo", RESOURCE_PROTOCOL_INFO_VALUES);
+    	/* the SDK value is published again when a limit is cleared */
+    	service->GetStateVariableValue("TracksMax", m_sdkTracksMax);
+
+    	if (m_tracksMax) {
+    		service->SetStateVariable("TracksMax", NPT_String::FromInteger(m_tracksMax));
+    	}
 
-    	service->SetStateVariable("Shuffle", NPT_String::FromInteger(m_renderer->getShuffle()));
-    	service->SetStateVariable("Repeat", NPT_String::FromInteger(m_renderer->getRepeat()));
+    	service->SetStateVariable("Shuffle", NPT_String::FromInteger(m_rendererStatus.shuffle()));
+    	service->SetStateVariable("Repeat", NPT_String::FromInteger(m_rendererStatus.repeat()));
 
 		/* resume automatic eventing */
     	service->PauseEventing(false);
@@ -228,16 +495,106 @@ NPT_Result MyOHPlaylist::SetupServices()
 		/* pause automatic eventing, we change multiple state vars */
 		service->PauseEventing(true);
 
-		service->SetStateVariable("Volume", NPT_String::FromInteger(m_renderer->getVolume()));
-		service->SetStateVariable("Mute", NPT_String::FromInteger(m_renderer->getMute()));
+		service->SetStateVariable("Volume", NPT_String::FromInteger(m_rendererStatus.volume()));
+		service->SetStateVariable("Mute", NPT_String::FromInteger(m_rendererStatus.mute()));
+
+		/* knob turns must not flood the subscribers */
+		service->SetStateVariableRate("Volume", NPT_TimeInterval(0.2));
 
 		/* resume automatic eventing */
 		service->PauseEventing(false);
     }
 
+    /* vendor extension, only used by our own control points */
+    service = new PLT_Service(this, PLAYLIST_EXT_SERVICE_TYPE, PLAYLIST_EXT_SERVICE_ID, "PlaylistExt");
+
+    if (NPT_FAILED(service->SetSCPDXML((const char*)MY_PlaylistExtSCPD)) || NPT_FAILED(AddService(service))) {
+    	delete service;
+    	return NPT_FAILURE;
+    }
+
     return NPT_SUCCESS;
 }
 
+/**
+ * Dispatches the vendor actions, everything else is handled by PLT_OHPlaylist.
+ */
+NPT_Result MyOHPlaylist::OnAction(PLT_ActionReference& action, const PLT_HttpRequestContext& context)
+{
+	ML_ENTRY_EXIT();
+
+	NPT_String name = action->GetActionDesc().GetName();
+	NPT_String serviceType = action->GetActionDesc().GetService()->GetServiceType();
+
+	if ((serviceType.Compare("urn:av-openhome-org:service:Info:1") == 0) ||
+		(serviceType.Compare("urn:av-openhome-org:service:Time:1") == 0)) {
+		MY_LOCK_GUARD(lock, m_mutex);
+
+		RefreshLazyState(serviceType);
+
+		if (serviceType.Compare("urn:av-openhome-org:service:Time:1") == 0) {
+			PLT_Service* service = action->GetActionDesc().GetService();
+
+			/* position on demand, not as of the last renderer tick */
+			service->SetStateVariable("Seconds", NPT_String::FromInteger(m_clock.seconds()));
+		}
+	}
+
+	if ((serviceType.Compare("urn:av-openhome-org:service:Playlist:1") == 0) && (name.Compare("IdArrayChanged") == 0)) {
+		return OnPlaylistIdArrayChanged(action);
+	}
+
+	if (serviceType.Compare(PLAYLIST_EXT_SERVICE_TYPE) == 0) {
+		if (name.Compare("InsertBatch") == 0) {
+			return OnPlaylistInsertBatch(action);
+		}
+
+		if (name.Compare("ReadRange") == 0) {
+			return OnPlaylistReadRange(action);
+		}
+
+		if (name.Compare("CompactDuplicates") == 0) {
+			return OnPlaylistCompactDuplicates(action);
+		}
+
+		action->SetError(401, "No Such Action.");
+		return NPT_FAILURE;
+	}
+
+	return PLT_OHPlaylist::OnAction(action, context);
+}
+
+/**
+ * Tracks the subscribers, a new subscriber gets the deferred state
+ * computed before the SDK sends the initial event.
+ */
+NPT_Result MyOHPlaylist::ProcessHttpSubscriberRequest(NPT_HttpRequest& request,
+													  const NPT_HttpRequestContext& context,
+													  NPT_HttpResponse& response)
+{
+	ML_ENTRY_EXIT();
+
+	PLT_Service* service = NULL;
+	NPT_Result result;
+
+	if (NPT_FAILED(FindServiceByEventSubURL(request.GetUrl().ToRequestString(true), service, true))) {
+		return PLT_OHPlaylist::ProcessHttpSubscriberRequest(request, context, response);
+	}
+
+	/* hold the lock, no state update must slip in before the subscriber is known */
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	if (request.GetMethod().Compare("SUBSCRIBE") == 0) {
+		RefreshLazyState(service->GetServiceType());
+	}
+
+	result = PLT_OHPlaylist::ProcessHttpSubscriberRequest(request, context, response);
+
+	m_subscriptions.update(request, response, service->GetServiceType());
+
+	return result;
+}
+
 /**
  *
  */
@@ -270,9 +627,574 @@ void MyOHPlaylist::createIdArray(NPT_String& idArray)
 		}
 #endif
 
-		NPT_Base64::Encode((const NPT_Byte *)idArrayByte, m_mediaItems.size() * 4, idArray);
+		NPT_Base64::Encode((const NPT_Byte *)idArrayByte, m_mediaItems.size() * 4, idArray);
+
+		delete[] idArrayByte;
+	}
+}
+
+/**
+ * Returns the current item with plain meta data, the previous
+ * current item becomes cold and is packed if over budget.
+ */
+std::shared_ptr<MediaItem> MyOHPlaylist::currentItem()
+{
+	std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
+	std::shared_ptr<MediaItem> previous = m_activeItem.lock();
+
+	if (MyDidlCodec::isPacked(item->ohPltMetadata)) {
+		unpackMetadata(item);
+	}
+
+	if (previous && (previous != item) && m_metadataBudget && (m_didlStats.plainBytes > m_metadataBudget)) {
+		packMetadata(previous);
+	}
+
+	m_activeItem = item;
+
+	return item;
+}
+
+/**
+ * Adds (or removes) the meta data of an item to the memory accounting.
+ */
+void MyOHPlaylist::accountMetadata(const std::shared_ptr<MediaItem>& item, bool add)
+{
+	size_t& bytes = MyDidlCodec::isPacked(item->ohPltMetadata) ? m_didlStats.packedBytes : m_didlStats.plainBytes;
+
+	if (add) {
+		bytes += item->ohPltMetadata.size();
+	}
+	else {
+		bytes -= std::min(bytes, item->ohPltMetadata.size());
+	}
+}
+
+/**
+ * Text held by the parsed MetaData (title, artists, album, URIs of
+ * resources and album art, ...), all of it is copied from the text
+ * nodes of the DIDL. Packed DIDL isn't scanned, returns 0.
+ */
+static size_t didl_text_bytes(const std::string& didl)
+{
+	size_t bytes = 0;
+	bool tag = false;
+
+	if (MyDidlCodec::isPacked(didl)) {
+		return 0;
+	}
+
+	for (char c : didl) {
+		if (c == '<') {
+			tag = true;
+		}
+		else if (c == '>') {
+			tag = false;
+		}
+		else if (!tag) {
+			bytes++;
+		}
+	}
+
+	return bytes;
+}
+
+/**
+ * Memory held by an item apart from its meta data DIDL: the item
+ * itself, the URIs and the parsed MetaData including its strings.
+ */
+static size_t item_bytes(const std::shared_ptr<MediaItem>& item)
+{
+	size_t bytes = sizeof(MediaItem) + item->uri.capacity() + item->ohPltURI.capacity();
+	std::shared_ptr<MetaData> metaData = item->getMetaData();
+
+	if (metaData) {
+		bytes += sizeof(MetaData) + metaData->resources.capacity() * sizeof(metaData->resources[0]);
+		bytes += didl_text_bytes(item->ohPltMetadata);
+	}
+
+	return bytes;
+}
+
+/**
+ * Adds (or removes) an item to the memory accounting. The bytes are
+ * remembered per id, the DIDL may be packed by the time it's removed.
+ */
+void MyOHPlaylist::accountItem(const std::shared_ptr<MediaItem>& item, bool add)
+{
+	if (add) {
+		size_t bytes = item_bytes(item);
+
+		m_itemBytesById[item->ohPltID] = bytes;
+		m_itemBytes += bytes;
+	}
+	else {
+		auto it = m_itemBytesById.find(item->ohPltID);
+		size_t bytes = (it != m_itemBytesById.end()) ? it->second : item_bytes(item);
+
+		if (it != m_itemBytesById.end()) {
+			m_itemBytesById.erase(it);
+		}
+
+		m_itemBytes -= std::min(m_itemBytes, bytes);
+	}
+
+	accountMetadata(item, add);
+}
+
+/**
+ * Bytes held by the playlist (items, URIs, MetaData, DIDL as stored, URI index).
+ */
+size_t MyOHPlaylist::usedBytes()
+{
+	return m_itemBytes + m_uriIndexBytes + m_didlStats.plainBytes + m_didlStats.packedBytes;
+}
+
+/**
+ * Checks if the items fit into TracksMax and the byte budget. Meta
+ * data is counted unpacked, so a batch is never admitted just because
+ * it might be packed afterwards.
+ */
+bool MyOHPlaylist::admitItems(const MediaItems& items)
+{
+	size_t bytes = 0;
+
+	if (m_tracksMax && (m_mediaItems.size() + items.size() > m_tracksMax)) {
+		ML_LOG_DEBUG("playlist full, [%zu] + [%zu] tracks exceed TracksMax [%zu]\n", m_mediaItems.size(), items.size(), m_tracksMax);
+		return false;
+	}
+
+	for (auto& item : items) {
+		bytes += item_bytes(item) + item->ohPltMetadata.size();
+	}
+
+	if (m_bytesMax && (usedBytes() + bytes > m_bytesMax)) {
+		ML_LOG_DEBUG("playlist full, [%zu] + [%zu] bytes exceed budget [%zu]\n", usedBytes(), bytes, m_bytesMax);
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Key of the URI index: scheme and host are case insensitive,
+ * surrounding white space is dropped. The rest of the URI is kept
+ * as is, servers may have case sensitive paths and queries.
+ */
+static std::string normalize_uri(const std::string& uri)
+{
+	size_t first = uri.find_first_not_of(" \t\r\n");
+	size_t last = uri.find_last_not_of(" \t\r\n");
+
+	if (first == std::string::npos) {
+		return "";
+	}
+
+	std::string key = uri.substr(first, last - first + 1);
+	size_t scheme = key.find("://");
+	size_t end = (scheme == std::string::npos) ? 0 : key.find('/', scheme + 3);
+
+	if (scheme != std::string::npos) {
+		std::transform(key.begin(), (end == std::string::npos) ? key.end() : key.begin() + end, key.begin(), ::tolower);
+	}
+
+	return key;
+}
+
+/**
+ * Adds (or removes) an item to the URI index used to find duplicates,
+ * the index is only kept while de-duplication is on.
+ */
+void MyOHPlaylist::indexUri(const std::shared_ptr<MediaItem>& item, bool add)
+{
+	if (m_dedupMode == DedupMode::Off) {
+		return;
+	}
+
+	std::string key = normalize_uri(item->ohPltURI);
+	size_t bytes = key.capacity() + sizeof(std::pair<const std::string, int>) + 2 * sizeof(void*);
+
+	if (add) {
+		m_uriIndex.insert(std::make_pair(key, item->ohPltID));
+		m_uriIndexBytes += bytes;
+		return;
+	}
+
+	auto range = m_uriIndex.equal_range(key);
+
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == item->ohPltID) {
+			m_uriIndex.erase(it);
+			m_uriIndexBytes -= std::min(bytes, m_uriIndexBytes);
+			break;
+		}
+	}
+}
+
+/**
+ * Id of a queued track with the same URI, -1 if none.
+ */
+int MyOHPlaylist::findDuplicate(const std::shared_ptr<MediaItem>& item)
+{
+	auto it = m_uriIndex.find(normalize_uri(item->ohPltURI));
+
+	return (it != m_uriIndex.end()) ? it->second : -1;
+}
+
+/**
+ * Removes the items already queued (or twice in items) depending
+ * on the de-duplication mode. Returns false if they are rejected.
+ */
+bool MyOHPlaylist::filterDuplicates(MediaItems& items)
+{
+	std::unordered_set<std::string> keys;
+	MediaItems unique;
+
+	if (m_dedupMode == DedupMode::Off) {
+		return true;
+	}
+
+	for (auto& item : items) {
+		std::string key = normalize_uri(item->ohPltURI);
+
+		if ((findDuplicate(item) != -1) || !keys.insert(key).second) {
+			if (m_dedupMode == DedupMode::Reject) {
+				m_duplicatesRejected++;
+				return false;
+			}
+
+			m_duplicatesCollapsed++;
+			continue;
+		}
+
+		unique.push_back(item);
+	}
+
+	items.swap(unique);
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::setDedupMode(DedupMode mode)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	if (mode == DedupMode::Off) {
+		std::unordered_multimap<std::string, int>().swap(m_uriIndex);
+		m_uriIndexBytes = 0;
+	}
+
+	bool build = (m_dedupMode == DedupMode::Off) && (mode != DedupMode::Off);
+
+	m_dedupMode = mode;
+
+	if (build) {
+		m_uriIndex.reserve(m_mediaItems.size());
+
+		for (auto& item : m_mediaItems) {
+			indexUri(item, true);
+		}
+	}
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::setPlaylistLimits(size_t tracksMax, size_t bytesMax)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+	PLT_Service* service = NULL;
+
+	m_tracksMax = tracksMax;
+	m_bytesMax = bytesMax;
+
+	/* tracks already queued are kept, only new inserts are refused */
+	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", service))) {
+		service->SetStateVariable("TracksMax", m_tracksMax ? NPT_String::FromInteger(m_tracksMax) : m_sdkTracksMax);
+	}
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::packMetadata(const std::shared_ptr<MediaItem>& item)
+{
+	std::string packed;
+
+	if (MyDidlCodec::isPacked(item->ohPltMetadata) || item->ohPltMetadata.empty()) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	MyDidlCodec::pack(item->ohPltMetadata, packed);
+
+	m_didlStats.packMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	m_didlStats.packs++;
+	m_didlStats.packIn += item->ohPltMetadata.size();
+	m_didlStats.packOut += packed.size();
+
+	accountMetadata(item, false);
+	item->ohPltMetadata.swap(packed);
+	accountMetadata(item, true);
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::unpackMetadata(const std::shared_ptr<MediaItem>& item)
+{
+	std::string didl;
+
+	readMetadata(item, didl);
+
+	accountMetadata(item, false);
+	item->ohPltMetadata.swap(didl);
+	accountMetadata(item, true);
+}
+
+/**
+ * Returns the plain meta data of an item without changing how it's stored.
+ */
+void MyOHPlaylist::readMetadata(const std::shared_ptr<MediaItem>& item, std::string& didl)
+{
+	if (!MyDidlCodec::isPacked(item->ohPltMetadata)) {
+		didl = item->ohPltMetadata;
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (!MyDidlCodec::unpack(item->ohPltMetadata, didl)) {
+		ML_LOG_DEBUG("corrupt packed meta data for ID %d\n", item->ohPltID);
+		didl.clear();
+	}
+
+	m_didlStats.unpackMicros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	m_didlStats.unpacks++;
+}
+
+/**
+ * Packs cold items until the plain meta data fits into the budget.
+ */
+void MyOHPlaylist::trimMetadata()
+{
+	int index = 0;
+
+	for (auto item : m_mediaItems) {
+		if (m_metadataBudget == 0) {
+			/* disabled, restore the plain meta data */
+			if (MyDidlCodec::isPacked(item->ohPltMetadata)) {
+				unpackMetadata(item);
+			}
+		}
+		else if (m_didlStats.plainBytes <= m_metadataBudget) {
+			break;
+		}
+		else if (index != m_index) {
+			packMetadata(item);
+		}
+
+		index++;
+	}
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::setMetadataBudget(size_t bytes)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	m_metadataBudget = bytes;
+
+	/* no reader must see meta data which is about to be packed in place */
+	publishSnapshot(true);
+
+	trimMetadata();
+
+	publishSnapshot();
+}
+
+/**
+ *
+ */
+void MyOHPlaylist::dumpMetadataStats()
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	ML_LOG_DEBUG("meta data budget [%zu] plain [%zu] packed [%zu] items [%zu]\n",
+				 m_metadataBudget, m_didlStats.plainBytes, m_didlStats.packedBytes, m_mediaItems.size());
+
+	ML_LOG_DEBUG("playlist tracks [%zu] of [%zu], bytes [%zu] of [%zu] (items and URIs [%zu])\n",
+				 m_mediaItems.size(), m_tracksMax, usedBytes(), m_bytesMax, m_itemBytes);
+
+	ML_LOG_DEBUG("duplicates rejected [%lu] collapsed [%lu] compacted [%lu]\n",
+				 m_duplicatesRejected, m_duplicatesCollapsed, m_duplicatesCompacted);
+
+	ML_LOG_DEBUG("meta data packs [%lu] ratio [%.2f] avg [%.1f us], unpacks [%lu] avg [%.1f us]\n",
+				 m_didlStats.packs,
+				 m_didlStats.packOut ? (double)m_didlStats.packIn / m_didlStats.packOut : 0.0,
+				 m_didlStats.packs ? (double)m_didlStats.packMicros / m_didlStats.packs : 0.0,
+				 m_didlStats.unpacks,
+				 m_didlStats.unpacks ? (double)m_didlStats.unpackMicros / m_didlStats.unpacks : 0.0);
+}
+
+/**
+ * Creates a playlist item from the DIDL meta data, NULL if it's not usable.
+ * Doesn't touch the playlist.
+ */
+std::shared_ptr<MediaItem> MyOHPlaylist::createPlaylistItem(const NPT_String& uri, const NPT_String& meta, bool& playable)
+{
+	std::shared_ptr<MediaItem> mediaItem = nullptr;
+
+	playable = true;
+
+	if (!meta.IsEmpty()) {
+	    PLT_MediaObjectListReference list;
+	    PLT_MediaObject* object = NULL;
+
+	    if (NPT_SUCCEEDED(PLT_Didl::FromDidl(meta, list))) {
+	    	ML_LOG_DEBUG("object list count [%d]\n", list->GetItemCount());
+
+			/* get the first object of the list */
+			list->Get(0, object);
+
+			/* best resource first, no play attempt for tracks we can't decode */
+			if (object && !selectResources(object)) {
+				ML_LOG_DEBUG("no playable resource for %s\n", uri.GetChars());
+
+				playable = false;
+				object = NULL;
+			}
+
+			if (object) {
+				std::shared_ptr<MetaData> metaData = create_metadata_from_media_object(object);
+
+				if (metaData) {
+					mediaItem = createMediaItem();
+
+					upnp_update_playlist_from_metadata(mediaItem, metaData);
+
+					if ((_mylogger_log_level_ && ML_LOG_MASK) > 1) {
+						MediaItem::dump(mediaItem);
+					}
+
+				    mediaItem->origin = kMediaItemOriginOpenHome;
+				    mediaItem->ohPltURI = uri.GetChars();
+				    mediaItem->ohPltMetadata = meta.GetChars();
+				}
+			}
+	    }
+	}
+
+	return mediaItem;
+}
+
+/**
+ * Position to insert after afterId, 0 is the start of the playlist.
+ */
+bool MyOHPlaylist::findInsertPosition(int afterId, MediaItemsIt& it)
+{
+	if (afterId == 0) {
+		it = m_mediaItems.begin();
+		return true;
+	}
+
+	for (it = m_mediaItems.begin(); it != m_mediaItems.end(); ++it) {
+		if ((*it)->ohPltID == afterId) {
+			++it;  /* we insert after the id, not before */
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Assigns the ids and inserts the items at it, returns the first new id.
+ */
+int MyOHPlaylist::insertItems(MediaItemsIt it, MediaItems& items)
+{
+	int position = it - m_mediaItems.begin();
+	int firstId = m_id + 1;
+
+	for (auto item : items) {
+	    m_id++;
+
+	    item->ohPltID = m_id;
+
+	    accountItem(item, true);
+	    indexUri(item, true);
+
+	    /* a new item is always cold */
+	    if (m_metadataBudget && (m_didlStats.plainBytes > m_metadataBudget)) {
+	    	packMetadata(item);
+	    }
+
+	    ML_LOG_DEBUG("-> ID %d\n", m_id);
+	}
+
+	m_mediaItems.insert(it, items.begin(), items.end());
+
+	/* m_index has to follow the current track */
+	if ((m_index != -1) && (position <= m_index)) {
+		m_index += items.size();
+	}
+
+	return firstId;
+}
+
+/**
+ * Rebuilds IdArray after a change of the playlist. The token only
+ * advances if the array really changed, each token is kept in a
+ * small ring together with its array for IdArrayChanged.
+ */
+void MyOHPlaylist::advanceIdArray()
+{
+	NPT_String idArray;
+
+	createIdArray(idArray);
+
+	if (idArray == m_idArray) {
+		return;
+	}
+
+	m_idArray = idArray;
+	m_token++;
+
+	m_tokenHistory[m_token % ID_ARRAY_TOKEN_HISTORY] = TokenHistoryEntry(m_token, m_idArray);
+
+	m_snapshotDirty = true;
+}
+
+/**
+ * Need to update IdArray after every change of the playlist.
+ */
+void MyOHPlaylist::publishIdArray()
+{
+	PLT_Service* playlistService = NULL;
 
-		delete[] idArrayByte;
+	advanceIdArray();
+
+	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", playlistService))) {
+		playlistService->PauseEventing(true);
+
+		playlistService->SetStateVariable("IdArray", m_idArray);
+		playlistService->SetStateVariable("IdArrayToken", NPT_String::FromInteger(m_token));
+
+		playlistService->PauseEventing(false);
 	}
 }
 
@@ -283,14 +1205,14 @@ NPT_Result MyOHPlaylist::OnPlaylistInsert(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
 	NPT_Int32 afterId;
 	NPT_String afterIdString;
 
-	NPT_String tmp;
 	NPT_String uri;
 	NPT_String meta;
 
+	auto start = std::chrono::steady_clock::now();
+
 	NPT_CHECK_SEVERE(action->GetArgumentValue("AfterId", afterIdString));
 	ML_LOG_DEBUG("OnPlaylistInsert AfterId  %s\n", afterIdString.GetChars());
 	NPT_CHECK_SEVERE(afterIdString.ToInteger32(afterId));
@@ -301,92 +1223,196 @@ NPT_Result MyOHPlaylist::OnPlaylistInsert(PLT_ActionReference& action)
 	NPT_CHECK_SEVERE(action->GetArgumentValue("Metadata", meta));
 	ML_LOG_DEBUG("OnPlaylistInsert Metadata  %s\n", meta.GetChars());
 
-	if (!meta.IsEmpty()) {
-	    PLT_MediaObjectListReference list;
-	    PLT_MediaObject* object = NULL;
+	/* DIDL parsing doesn't need the lock */
+	bool playable;
+	std::shared_ptr<MediaItem> mediaItem = createPlaylistItem(uri, meta, playable);
 
-	    if (NPT_SUCCEEDED(PLT_Didl::FromDidl(meta, list))) {
-	    	ML_LOG_DEBUG("object list count [%d]\n", list->GetItemCount());
+	if (!playable) {
+		action->SetError(803, "Track not playable");
+		return NPT_FAILURE;
+	}
 
-			/* get the first object of the list */
-			list->Get(0, object);
+	MY_LOCK_GUARD(lock, m_mutex);
 
-			if (object) {
-				std::shared_ptr<MetaData> metaData = create_metadata_from_media_object(object);
+	if (mediaItem) {
+		MediaItemsIt it;
+		MediaItems items(1, mediaItem);
 
-				if (metaData) {
-					std::shared_ptr<MediaItem> mediaItem = std::make_shared<MediaItem>();
+		if (!findInsertPosition(afterId, it)) {
+        	ML_LOG_DEBUG("not found\n");
 
-					upnp_update_playlist_from_metadata(mediaItem, metaData);
+        	return NPT_ERROR_NOT_IMPLEMENTED;
+		}
 
-					if ((_mylogger_log_level_ && ML_LOG_MASK) > 1) {
-						MediaItem::dump(mediaItem);
-					}
+		if ((m_dedupMode != DedupMode::Off) && (findDuplicate(mediaItem) != -1)) {
+			if (m_dedupMode == DedupMode::Reject) {
+				m_duplicatesRejected++;
+
+				action->SetError(802, "Duplicate track");
+				return NPT_FAILURE;
+			}
 
-					MediaItemsIt it;
-				    if (afterId == 0) {
-				    	it = m_mediaItems.begin();
-				    }
-				    else {
-				    	for (it = m_mediaItems.begin(); it != m_mediaItems.end(); ++it) {
-				    		if ((*it)->ohPltID == afterId) {
-				    			break;
-				    		}
-				    	}
+			/* collapsed, the CP gets the id of the track already queued */
+			m_duplicatesCollapsed++;
 
-				        if(it == m_mediaItems.end()) {
-				        	ML_LOG_DEBUG("not found\n");
+			action->SetArgumentValue("NewId", NPT_String::FromInteger(findDuplicate(mediaItem)));
+			return NPT_SUCCESS;
+		}
 
-				        	mediaItem.reset();
+		if (!admitItems(items)) {
+			action->SetError(801, "Playlist full");
+			return NPT_FAILURE;
+		}
 
-				        	return NPT_ERROR_NOT_IMPLEMENTED;
-				        }
-				        
-				        ++it;  /* we insert after the id, not before */
-				    }
+		insertItems(it, items);
 
-				    m_id++;
+		publishIdArray();
 
-				    mediaItem->origin = kMediaItemOriginOpenHome;
-				    mediaItem->ohPltID = m_id;
-				    mediaItem->ohPltURI = uri.GetChars();
-				    mediaItem->ohPltMetadata = meta.GetChars();
+		action->SetArgumentValue("NewId", NPT_String::FromInteger(m_id));
+	}
 
-				    m_mediaItems.insert(it, mediaItem);
+	ML_LOG_DEBUG("OnPlaylistInsert took [%lld] us\n",
+				 (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
 
-				    ML_LOG_DEBUG("-> ID %d\n", m_id);
+	return NPT_SUCCESS;
+}
 
-					/* need to update ID after every insert */
-					{
-						PLT_Service* playlistService = NULL;
+/**
+ * Vendor action, inserts a list of tracks after AfterId at once.
+ * Entries has the same format as the TrackList of ReadList:
+ * <TrackList><Entry><Uri/><Metadata/></Entry>...</TrackList>
+ * The DIDL is parsed on up to m_parserThreads threads without
+ * holding the lock, the items are spliced in afterwards.
+ */
+NPT_Result MyOHPlaylist::OnPlaylistInsertBatch(PLT_ActionReference& action)
+{
+	ML_ENTRY_EXIT();
 
-						if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", playlistService))) {
-							playlistService->PauseEventing(true);
+	NPT_Int32 afterId;
+	NPT_String afterIdString;
+	NPT_String entries;
+	NPT_XmlParser parser;
+	NPT_XmlNode* tree = NULL;
+	NPT_Array<NPT_XmlElementNode*> entryNodes;
+	std::vector<NPT_String> uris;
+	std::vector<NPT_String> metas;
+	MediaItems items;
+	MediaItemsIt it;
+	int firstId = 0;
+	int lastId = 0;
+	unsigned int threads = m_parserThreads;
 
-							/**
-							 * Id: The id of the current track (the track currently playing or that would
-							 * be played if the Play action was invoked). Or 0 if the playlist is empty.
-							 */
-							createIdArray(m_idArray);
+	auto start = std::chrono::steady_clock::now();
 
-							playlistService->SetStateVariable("IdArray", m_idArray);
+	NPT_CHECK_SEVERE(action->GetArgumentValue("AfterId", afterIdString));
+	ML_LOG_DEBUG("OnPlaylistInsertBatch AfterId  %s\n", afterIdString.GetChars());
+	NPT_CHECK_SEVERE(afterIdString.ToInteger32(afterId));
 
-							m_token++;
-							playlistService->SetStateVariable("IdArrayToken", NPT_String::FromInteger(m_token));
+	NPT_CHECK_SEVERE(action->GetArgumentValue("Entries", entries));
 
-							playlistService->PauseEventing(false);
-						}
-					}
-				}
+	if (NPT_FAILED(parser.Parse(entries, tree)) || !tree || !tree->AsElementNode()) {
+		delete tree;
 
-				action->SetArgumentValue("NewId", NPT_String::FromInteger(m_id));
-			}
-	    }
+		action->SetError(402, "Invalid Args");
+		return NPT_FAILURE;
+	}
+
+	PLT_XmlHelper::GetChildren(tree->AsElementNode(), entryNodes, "Entry");
+
+	for (NPT_Cardinal i = 0; i < entryNodes.GetItemCount(); i++) {
+		NPT_String uri;
+		NPT_String meta;
+
+		PLT_XmlHelper::GetChildText(entryNodes[i], "Uri", uri, "", PLAYLIST_EXT_MAX_METADATA);
+		PLT_XmlHelper::GetChildText(entryNodes[i], "Metadata", meta, "", PLAYLIST_EXT_MAX_METADATA);
+
+		uris.push_back(uri);
+		metas.push_back(meta);
+	}
+
+	delete tree;
+
+	/* pure CPU work, one slot per entry keeps the order */
+	std::vector<std::shared_ptr<MediaItem> > parsed(uris.size());
+	std::vector<char> playables(uris.size(), 0);
+
+	my_parallel_for(uris.size(), threads, [&](size_t i) {
+		bool playable;
+
+		parsed[i] = createPlaylistItem(uris[i], metas[i], playable);
+		playables[i] = playable;
+	});
+
+	/* all or nothing, a bad entry rejects the whole batch */
+	for (size_t i = 0; i < parsed.size(); i++) {
+		if (!playables[i]) {
+			ML_LOG_DEBUG("OnPlaylistInsertBatch entry [%u] not playable\n", (unsigned int)i);
+
+			action->SetError(803, "Track not playable");
+			return NPT_FAILURE;
+		}
+
+		if (!parsed[i]) {
+			ML_LOG_DEBUG("OnPlaylistInsertBatch entry [%u] invalid\n", (unsigned int)i);
+
+			action->SetError(402, "Invalid Args");
+			return NPT_FAILURE;
+		}
+
+		items.push_back(parsed[i]);
+	}
+
+	auto parsedAt = std::chrono::steady_clock::now();
+
+	{
+		MY_LOCK_GUARD(lock, m_mutex);
+
+		if (!findInsertPosition(afterId, it)) {
+		    action->SetError(401,"Id not found");
+		    return NPT_FAILURE;
+		}
+
+		if (!filterDuplicates(items)) {
+			action->SetError(802, "Duplicate track");
+			return NPT_FAILURE;
+		}
+
+		/* all or nothing */
+		if (!admitItems(items)) {
+			action->SetError(801, "Playlist full");
+			return NPT_FAILURE;
+		}
+
+		if (!items.empty()) {
+			firstId = insertItems(it, items);
+			lastId = m_id;
+
+			/* one state update for the whole batch */
+			publishIdArray();
+		}
 	}
 
+	action->SetArgumentValue("FirstId", NPT_String::FromInteger(firstId));
+	action->SetArgumentValue("LastId", NPT_String::FromInteger(lastId));
+
+	ML_LOG_DEBUG("OnPlaylistInsertBatch [%u] tracks took [%lld] us, parsing [%lld] us on [%u] threads\n", (unsigned int)items.size(),
+				 (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(),
+				 (long long)std::chrono::duration_cast<std::chrono::microseconds>(parsedAt - start).count(),
+				 threads);
+
 	return NPT_SUCCESS;
 }
 
+/**
+ *
+ */
+void MyOHPlaylist::setParserThreads(unsigned int threads)
+{
+	ML_ENTRY_EXIT();
+
+	m_parserThreads = std::max(1u, std::min(threads, (unsigned int)MY_PARALLEL_MAX_THREADS));
+}
+
 /**
  *
  */
@@ -394,19 +1420,69 @@ NPT_Result MyOHPlaylist::OnPlaylistIdArray(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	std::shared_ptr<PlaylistSnapshot> snapshot = currentSnapshot();
 
-	createIdArray(m_idArray);
+	/* the array is kept up to date by every change, reading it must not advance the token */
+	m_idArrayReads++;
+	m_snapshotReads++;
 
-	action->SetArgumentValue("Array", m_idArray);
+	action->SetArgumentValue("Token", NPT_String::FromInteger(snapshot->token));
+	action->SetArgumentValue("Array", snapshot->idArray);
 
-	m_token++;
+	return NPT_SUCCESS;
+}
+
+/**
+ * Answered from the token ring, a token which fell out of the
+ * ring is reported as changed.
+ */
+NPT_Result MyOHPlaylist::OnPlaylistIdArrayChanged(PLT_ActionReference& action)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+	NPT_String token;
+	int tokenValue = -1;
+	bool changed = true;
 
-	action->SetArgumentValue("Token", NPT_String::FromInteger(m_token));
+	NPT_CHECK_SEVERE(action->GetArgumentValue("Token", token));
+	NPT_CHECK_SEVERE(token.ToInteger32(tokenValue));
+
+	m_idArrayChangedCalls++;
+
+	if (tokenValue == m_token) {
+		changed = false;
+	}
+	else if ((tokenValue > 0) && (tokenValue < m_token)) {
+		const TokenHistoryEntry& entry = m_tokenHistory[tokenValue % ID_ARRAY_TOKEN_HISTORY];
+		const TokenHistoryEntry& current = m_tokenHistory[m_token % ID_ARRAY_TOKEN_HISTORY];
+
+		/* the hash only rules out, equal hashes need the arrays */
+		changed = (entry.token != tokenValue) || (entry.hash != current.hash) || (entry.idArray != current.idArray);
+	}
+
+	if (!changed) {
+		m_idArrayUnchanged++;
+	}
+
+	ML_LOG_DEBUG("OnPlaylistIdArrayChanged Token = %d (current %d) changed %d\n", tokenValue, m_token, changed);
+
+	action->SetArgumentValue("Value", changed ? "true" : "false");
 
 	return NPT_SUCCESS;
 }
 
+/**
+ *
+ */
+void MyOHPlaylist::dumpIdArrayStats()
+{
+	MY_LOCK_GUARD(lock, m_mutex);
+
+	ML_LOG_DEBUG("IdArray token [%d] reads [%lu], IdArrayChanged [%lu] of which unchanged (downloads avoided) [%lu]\n",
+				 m_token, m_idArrayReads.load(), m_idArrayChangedCalls, m_idArrayUnchanged);
+}
+
 /**
  *
  */
@@ -414,33 +1490,31 @@ NPT_Result MyOHPlaylist::OnPlaylistDeleteAll(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
+	cancelSettle();
 	m_renderer->stop(this);
 
-/* this are equale functions */
-#if 0
-	for (auto i : m_mediaItems) {
-		i.reset();
-	}
-#else
-	std::for_each(m_mediaItems.begin(), m_mediaItems.end(), [](std::shared_ptr<MediaItem> n){ n.reset();});
-#endif
+	clearMediaItems();
 
-	m_mediaItems.clear();
+	m_didlStats.plainBytes = 0;
+	m_didlStats.packedBytes = 0;
+	m_itemBytes = 0;
+	m_itemBytesById.clear();
+	m_uriIndex.clear();
+	m_uriIndexBytes = 0;
+	m_activeItem.reset();
 
 	/* SNK, m_id must be always increase !!!!!*/
 #if 0
 	m_id = 0;
 #endif
 
-	m_token++;
-
-	createIdArray(m_idArray);
+	advanceIdArray();
 
 	m_index = -1;
 
-	m_testTime = 0;
+	m_clock.reset();
 
 	UpdateState();
 
@@ -460,7 +1534,7 @@ NPT_Result MyOHPlaylist::OnPlaylistDeleteId(PLT_ActionReference& action)
 
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
 	NPT_CHECK_SEVERE(action->GetArgumentValue("Value", id));
 
@@ -481,30 +1555,41 @@ NPT_Result MyOHPlaylist::OnPlaylistDeleteId(PLT_ActionReference& action)
 	for (MediaItemsIt it = m_mediaItems.begin(); it != m_mediaItems.end(); ++it) {
 
 		if ((*it)->ohPltID == idValue) {
+			accountItem(*it, false);
+			indexUri(*it, false);
+
+			if (m_activeItem.lock() == *it) {
+				m_activeItem.reset();
+			}
+
 			(*it).reset();
 			m_mediaItems.erase(it);
 
 			if (index == m_index) {
 				/* we delete the current active element */
+				cancelSettle();
+
 				if (!m_mediaItems.empty()) {
-					if ((m_renderer->getState() == RendererState::Playing) || (m_renderer->getState() == RendererState::Paused)) {
-						std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
+					RendererState state = m_rendererStatus.state();
+
+					if ((state == RendererState::Playing) || (state == RendererState::Paused)) {
+						std::shared_ptr<MediaItem> item = currentItem();
 
 						/* does stop/play */
-						m_renderer->play(this, item);
+						m_renderer->play(this, cachedItem(item));
 
 						/* update the currentPltID with the new played !! */
 						currentPltID = item->ohPltID;
 					}
 
 					m_trackCount++;
-					m_testTime = 0;
+					m_clock.reset();
 				}
 				else {
 					/* was the last in playlist */
 					m_renderer->stop(this);
 
-					m_testTime = 0;
+					m_clock.reset();
 				}
 			}
 
@@ -530,9 +1615,7 @@ NPT_Result MyOHPlaylist::OnPlaylistDeleteId(PLT_ActionReference& action)
 		}
 	}
 
-	m_token++;
-	
-	createIdArray(m_idArray);
+	advanceIdArray();
 
 	UpdateState();
 
@@ -548,11 +1631,24 @@ NPT_Result MyOHPlaylist::OnPlaylistReadList(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	std::shared_ptr<PlaylistSnapshot> snapshot = currentSnapshot();
+	std::unique_lock<MyControllerMutex> lock(m_mutex, std::defer_lock);
+	const MediaItems* items = &snapshot->items;
 	NPT_List<NPT_String> ids;
 	NPT_List<NPT_String>::Iterator idsIt;
 	NPT_String idList;
 
+	if (!snapshot->metadataStable) {
+		/* packed meta data is swapped in place, only safe with the lock. Never wait for it holding a snapshot */
+		items = &m_mediaItems;
+		snapshot.reset();
+
+		lock.lock();
+		m_snapshotFallbacks++;
+	}
+
+	m_snapshotReads++;
+
 	NPT_CHECK_SEVERE(action->GetArgumentValue("IdList", idList));
 	ML_LOG_DEBUG( "OnPlaylistReadList IdList  %s\n", idList.GetChars());
 
@@ -566,23 +1662,9 @@ NPT_Result MyOHPlaylist::OnPlaylistReadList(PLT_ActionReference& action)
 
     	(*idsIt).ToInteger32(idInteger);
 
-    	for (MediaItemsIt it = m_mediaItems.begin(); it != m_mediaItems.end(); ++it) {
+    	for (MediaItems::const_iterator it = items->begin(); it != items->end(); ++it) {
     		if ((*it)->ohPltID == idInteger) {
-    			csxml+="<Entry>";
-
-    			csxml+="<Id>";
-    			csxml+= NPT_String::FromInteger((*it)->ohPltID);
-    			csxml+="</Id>";
-
-    			csxml+="<Uri>";
-    			PLT_Didl::AppendXmlEscape(csxml, (*it)->ohPltURI.c_str());
-    			csxml+="</Uri>";
-
-    			csxml+="<Metadata>";
-    			PLT_Didl::AppendXmlEscape(csxml, (*it)->ohPltMetadata.c_str());
-    			csxml+="</Metadata>";
-
-    			csxml+="</Entry>";
+    			appendEntry(csxml, *it, true);
 
     			break;
     		}
@@ -599,6 +1681,179 @@ NPT_Result MyOHPlaylist::OnPlaylistReadList(PLT_ActionReference& action)
 
 }
 
+/**
+ * Vendor action, reads a page of entries by index. The page ends after
+ * Count entries or once the TrackList exceeds PLAYLIST_EXT_MAX_PAGE_BYTES,
+ * NextIndex is the cursor for the next page (== Total at the end). If
+ * Token is given and the playlist changed meanwhile the read is refused,
+ * so the CP restarts instead of mixing two playlists.
+ */
+NPT_Result MyOHPlaylist::OnPlaylistReadRange(PLT_ActionReference& action)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+	NPT_String value;
+	NPT_String fields;
+	NPT_Int32 startIndex = 0;
+	NPT_Int32 count = 0;
+	NPT_Int32 token = 0;
+	bool metadata;
+	int index;
+
+	NPT_CHECK_SEVERE(action->GetArgumentValue("StartIndex", value));
+	NPT_CHECK_SEVERE(value.ToInteger32(startIndex));
+
+	NPT_CHECK_SEVERE(action->GetArgumentValue("Count", value));
+	NPT_CHECK_SEVERE(value.ToInteger32(count));
+
+	NPT_CHECK_SEVERE(action->GetArgumentValue("Token", value));
+	NPT_CHECK_SEVERE(value.ToInteger32(token));
+
+	NPT_CHECK_SEVERE(action->GetArgumentValue("Fields", fields));
+
+	ML_LOG_DEBUG("OnPlaylistReadRange StartIndex %d Count %d Token %d Fields %s\n", startIndex, count, token, fields.GetChars());
+
+	if ((token != 0) && (token != m_token)) {
+		action->SetError(801, "Token changed");
+		return NPT_FAILURE;
+	}
+
+	if ((startIndex < 0) || (startIndex > (int)m_mediaItems.size())) {
+		action->SetError(802, "Index out of range");
+		return NPT_FAILURE;
+	}
+
+	if ((count <= 0) || (count > PLAYLIST_EXT_MAX_PAGE_ENTRIES)) {
+		count = PLAYLIST_EXT_MAX_PAGE_ENTRIES;
+	}
+
+	/* "IdUri" leaves out the meta data, saves the unpacking and most of the bytes */
+	metadata = (fields.Compare("IdUri") != 0);
+
+	NPT_String csxml = "<TrackList>";
+
+	/* sized from the entries returned, meta data by the average held */
+	size_t entries = std::min((size_t)count, m_mediaItems.size() - startIndex);
+	size_t entryBytes = 128;
+
+	if (metadata && !m_mediaItems.empty()) {
+		entryBytes += (m_didlStats.plainBytes + m_didlStats.packedBytes) / m_mediaItems.size();
+	}
+
+	csxml.Reserve(std::min(entries * entryBytes, (size_t)PLAYLIST_EXT_MAX_PAGE_BYTES));
+
+	for (index = startIndex; (index < (int)m_mediaItems.size()) && (index < startIndex + count); index++) {
+		appendEntry(csxml, m_mediaItems[index], metadata);
+
+		if (csxml.GetLength() >= PLAYLIST_EXT_MAX_PAGE_BYTES) {
+			index++;
+			break;
+		}
+	}
+
+	csxml += "</TrackList>";
+
+	NPT_CHECK_SEVERE(action->SetArgumentValue("TrackList", csxml));
+	NPT_CHECK_SEVERE(action->SetArgumentValue("NextIndex", NPT_String::FromInteger(index)));
+	NPT_CHECK_SEVERE(action->SetArgumentValue("Total", NPT_String::FromInteger(m_mediaItems.size())));
+	NPT_CHECK_SEVERE(action->SetArgumentValue("CurrentToken", NPT_String::FromInteger(m_token)));
+
+	return NPT_SUCCESS;
+}
+
+/**
+ * Vendor action, removes the duplicates already queued (e.g. from
+ * before de-duplication was enabled). The first occurrence is kept,
+ * unless a later one is the current track.
+ */
+NPT_Result MyOHPlaylist::OnPlaylistCompactDuplicates(PLT_ActionReference& action)
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+	std::unordered_map<std::string, int> keepers; /* key -> id to keep */
+	int currentPltID = (m_index != -1) ? m_mediaItems[m_index]->ohPltID : -1;
+	size_t before = m_mediaItems.size();
+
+	if (currentPltID != -1) {
+		keepers[normalize_uri(m_mediaItems[m_index]->ohPltURI)] = currentPltID;
+	}
+
+	for (auto& item : m_mediaItems) {
+		keepers.insert(std::make_pair(normalize_uri(item->ohPltURI), item->ohPltID));
+	}
+
+	auto end = std::remove_if(m_mediaItems.begin(), m_mediaItems.end(), [&](const std::shared_ptr<MediaItem>& item) {
+		if (keepers[normalize_uri(item->ohPltURI)] == item->ohPltID) {
+			return false;
+		}
+
+		accountItem(item, false);
+		indexUri(item, false);
+
+		if (m_activeItem.lock() == item) {
+			m_activeItem.reset();
+		}
+
+		return true;
+	});
+
+	m_mediaItems.erase(end, m_mediaItems.end());
+
+	/* the current track is kept, only its index may move */
+	if (currentPltID != -1) {
+		for (size_t i = 0; i < m_mediaItems.size(); i++) {
+			if (m_mediaItems[i]->ohPltID == currentPltID) {
+				m_index = i;
+				break;
+			}
+		}
+	}
+
+	m_duplicatesCompacted += before - m_mediaItems.size();
+
+	ML_LOG_DEBUG("OnPlaylistCompactDuplicates removed [%zu] tracks\n", before - m_mediaItems.size());
+
+	if (m_mediaItems.size() != before) {
+		advanceIdArray();
+
+		UpdateState();
+	}
+
+	action->SetArgumentValue("Removed", NPT_String::FromInteger(before - m_mediaItems.size()));
+
+	return NPT_SUCCESS;
+}
+
+/**
+ * Appends an <Entry> as used by ReadList.
+ */
+void MyOHPlaylist::appendEntry(NPT_String& xml, const std::shared_ptr<MediaItem>& item, bool metadata)
+{
+	xml += "<Entry>";
+
+	xml += "<Id>";
+	xml += NPT_String::FromInteger(item->ohPltID);
+	xml += "</Id>";
+
+	xml += "<Uri>";
+	PLT_Didl::AppendXmlEscape(xml, item->ohPltURI.c_str());
+	xml += "</Uri>";
+
+	if (metadata) {
+		std::string didl;
+
+		readMetadata(item, didl);
+
+		xml += "<Metadata>";
+		PLT_Didl::AppendXmlEscape(xml, didl.c_str());
+		xml += "</Metadata>";
+	}
+
+	xml += "</Entry>";
+}
+
 /**
  * Index is from start of current playlist, not id dependend
  */
@@ -606,7 +1861,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekIndex(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	int index;
 	NPT_String value;
 
@@ -620,8 +1875,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekIndex(PLT_ActionReference& action)
 
 		m_trackCount++;
 
-		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-		m_renderer->play(this, item);
+		settlePlay();
 	}
 	else {
 		m_index = -1;
@@ -641,7 +1895,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekId(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	int index;
 	MediaItemsIt it;
 	NPT_String value;
@@ -667,8 +1921,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekId(PLT_ActionReference& action)
 
 		m_trackCount++;
 
-		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-		m_renderer->play(this, item);
+		settlePlay();
 	}
 	else {
 		/* error ? */
@@ -688,15 +1941,21 @@ NPT_Result MyOHPlaylist::OnPlaylistPlay(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
+	RendererState state = m_rendererStatus.state();
 
 	if (m_index != -1) {
-		if (m_renderer->getState() == RendererState::Paused) {
+		if (cancelSettle()) {
+			/* don't wait for the settle window, or start the target paused in it */
+			std::shared_ptr<MediaItem> item = currentItem();
+			m_renderer->play(this, cachedItem(item));
+		}
+		else if (state == RendererState::Paused) {
 			m_renderer->unpause(this);
 		}
-		else if (m_renderer->getState() == RendererState::Stopped) {
-			std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-			m_renderer->play(this, item);
+		else if (state == RendererState::Stopped) {
+			std::shared_ptr<MediaItem> item = currentItem();
+			m_renderer->play(this, cachedItem(item));
 		}
 
 		UpdateState();
@@ -718,12 +1977,28 @@ NPT_Result MyOHPlaylist::OnPlaylistPause(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
+	RendererState state = m_rendererStatus.state();
+	bool settlePaused = m_settlePaused;
 
-	if (m_renderer->getState() == RendererState::Playing) {
+	if (cancelSettle()) {
+		if (settlePaused) {
+			/* Pause toggles, start the target which was paused before it started */
+			std::shared_ptr<MediaItem> item = currentItem();
+			m_renderer->play(this, cachedItem(item));
+		}
+		else {
+			/* silence the track we skipped, the target is kept and reported Paused until Play */
+			m_renderer->stop(this);
+			m_clock.reset();
+
+			m_settlePaused = true;
+		}
+	}
+	else if (state == RendererState::Playing) {
 		m_renderer->pause(this);
 	}
-	else if (m_renderer->getState() == RendererState::Paused) {
+	else if (state == RendererState::Paused) {
 		m_renderer->unpause(this);
 	}
 
@@ -741,12 +2016,13 @@ NPT_Result MyOHPlaylist::OnPlaylistStop(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
 	/* if playint/pause -> stop */
+	cancelSettle();
 	m_renderer->stop(this);
 
-	m_testTime = 0;
+	m_clock.reset();
 
 	UpdateState();
 
@@ -762,14 +2038,14 @@ NPT_Result MyOHPlaylist::OnPlaylistNext(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
-	if (m_renderer->getShuffle() && (m_index != -1)) {
+	if (m_rendererStatus.shuffle() && (m_index != -1)) {
 		/* create random between 0 ... (m_mediaItems.size() - 1) */
 		m_index = rand() % m_mediaItems.size();
 	}
 
-	if ((m_index != -1) && (m_renderer->getRepeat() || (m_index < ((int)m_mediaItems.size() - 1)))) {
+	if ((m_index != -1) && (m_rendererStatus.repeat() || (m_index < ((int)m_mediaItems.size() - 1)))) {
 		m_index++;
 
 		m_index = (m_index % m_mediaItems.size());
@@ -779,10 +2055,10 @@ NPT_Result MyOHPlaylist::OnPlaylistNext(PLT_ActionReference& action)
 		 * Linn Kinsky will not update information on left top corner
 		 */
 		m_trackCount++;
-		m_testTime = 0;
+		m_clock.reset();
 
-		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-		m_renderer->play(this, item);
+		/* rapid skips only start the final target */
+		settlePlay();
 
 		UpdateState();
 
@@ -804,9 +2080,9 @@ NPT_Result MyOHPlaylist::OnPlaylistPrevious(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
-	if ((m_index != -1) && (m_renderer->getRepeat() || (m_index > 0))) {
+	if ((m_index != -1) && (m_rendererStatus.repeat() || (m_index > 0))) {
 		m_index--;
 
 		m_index = (m_index % m_mediaItems.size());
@@ -816,10 +2092,10 @@ NPT_Result MyOHPlaylist::OnPlaylistPrevious(PLT_ActionReference& action)
 		 * Linn Kinsky will not update information on left top corner
 		 */
 		m_trackCount++;
-		m_testTime = 0;
+		m_clock.reset();
 
-		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-		m_renderer->play(this, item);
+		/* rapid skips only start the final target */
+		settlePlay();
 
 		UpdateState();
 
@@ -841,7 +2117,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekSecondAbsolute(PLT_ActionReference& actio
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String value;
 	int time;
 
@@ -850,7 +2126,8 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekSecondAbsolute(PLT_ActionReference& actio
 
 	NPT_CHECK_SEVERE(value.ToInteger32(time));
 
-	m_renderer->seek(this, 0, time);
+	/* debounced, CPs send a seek for every step while scrubbing */
+	m_seek.seek(0, time);
 
 	return NPT_SUCCESS;
 }
@@ -862,7 +2139,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekSecondRelative(PLT_ActionReference& actio
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String value;
 	int time;
 
@@ -871,7 +2148,8 @@ NPT_Result MyOHPlaylist::OnPlaylistSeekSecondRelative(PLT_ActionReference& actio
 
 	NPT_CHECK_SEVERE(value.ToInteger32(time));
 
-	m_renderer->seek(this, 1, time);
+	/* debounced, CPs send a seek for every step while scrubbing */
+	m_seek.seek(1, time);
 
 	return NPT_SUCCESS;
 }
@@ -883,7 +2161,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetRepeat(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String value;
 	int repeate;
 
@@ -893,6 +2171,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetRepeat(PLT_ActionReference& action)
 	NPT_CHECK_SEVERE(value.ToInteger32(repeate));
 
 	m_renderer->setRepeat(this, repeate);
+	m_rendererStatus.setRepeat(repeate);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -900,7 +2179,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetRepeat(PLT_ActionReference& action)
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", service))) {
 		service->PauseEventing(true);
 
-		service->SetStateVariable("Repeat", NPT_String::FromInteger(m_renderer->getRepeat()));
+		service->SetStateVariable("Repeat", NPT_String::FromInteger(m_rendererStatus.repeat()));
 
 		service->PauseEventing(false);
 	}
@@ -916,7 +2195,7 @@ NPT_Result MyOHPlaylist::OnPlaylistRepeat(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	action->SetArgumentValue("Value", NPT_String::FromInteger(m_renderer->getRepeat()));
+	action->SetArgumentValue("Value", NPT_String::FromInteger(m_rendererStatus.repeat()));
 
 	return NPT_SUCCESS;
 }
@@ -928,7 +2207,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetShuffle(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String value;
 	int shuffle;
 
@@ -938,6 +2217,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetShuffle(PLT_ActionReference& action)
 	NPT_CHECK_SEVERE(value.ToInteger32(shuffle));
 
 	m_renderer->setShuffle(this, shuffle);
+	m_rendererStatus.setShuffle(shuffle);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -945,7 +2225,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetShuffle(PLT_ActionReference& action)
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Playlist:1", service))) {
 		service->PauseEventing(true);
 
-		service->SetStateVariable("Shuffle", NPT_String::FromInteger(m_renderer->getShuffle()));
+		service->SetStateVariable("Shuffle", NPT_String::FromInteger(m_rendererStatus.shuffle()));
 
 		service->PauseEventing(false);
 	}
@@ -961,7 +2241,7 @@ NPT_Result MyOHPlaylist::OnPlaylistShuffle(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	action->SetArgumentValue("Value", NPT_String::FromInteger(m_renderer->getShuffle()));
+	action->SetArgumentValue("Value", NPT_String::FromInteger(m_rendererStatus.shuffle()));
 
 	return NPT_SUCCESS;
 }
@@ -973,7 +2253,6 @@ NPT_Result MyOHPlaylist::OnPlaylistSetVolume(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
 	NPT_String value;
 	int volume;
 
@@ -982,7 +2261,8 @@ NPT_Result MyOHPlaylist::OnPlaylistSetVolume(PLT_ActionReference& action)
 
 	NPT_CHECK_SEVERE(value.ToInteger32(volume));
 
-	m_renderer->setVolume(this, volume);
+	/* coalesced, the renderer gets it on the scheduler thread */
+	m_volume.set(volume);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -1006,7 +2286,14 @@ NPT_Result MyOHPlaylist::OnPlaylistVolume(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	action->SetArgumentValue("Value", NPT_String::FromInteger(m_renderer->getVolume()));
+	int volume;
+
+	/* commands still being coalesced win */
+	if (!m_volume.pending(volume)) {
+		volume = m_rendererStatus.volume();
+	}
+
+	action->SetArgumentValue("Value", NPT_String::FromInteger(volume));
 
 	return NPT_SUCCESS;
 }
@@ -1018,13 +2305,7 @@ NPT_Result MyOHPlaylist::OnPlaylistVolumeInc(PLT_ActionReference& action __attri
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
-	int volume = m_renderer->getVolume();
-
-	if (volume < 100) {
-		volume++;
-		m_renderer->setVolume(this, volume);
-	}
+	m_volume.add(1);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -1048,13 +2329,7 @@ NPT_Result MyOHPlaylist::OnPlaylistVolumeDec(PLT_ActionReference& action __attri
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
-	int volume = m_renderer->getVolume();
-
-	if (volume > 0) {
-		volume--;
-		m_renderer->setVolume(this, volume);
-	}
+	m_volume.add(-1);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -1078,7 +2353,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetMute(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String value;
 	int mute;
 
@@ -1088,6 +2363,7 @@ NPT_Result MyOHPlaylist::OnPlaylistSetMute(PLT_ActionReference& action)
 	NPT_CHECK_SEVERE(value.ToInteger32(mute));
 
 	m_renderer->setMute(this, mute);
+	m_rendererStatus.setMute(mute);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -1111,7 +2387,7 @@ NPT_Result MyOHPlaylist::OnPlaylistMute(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	action->SetArgumentValue("Value", NPT_String::FromInteger(m_renderer->getMute()));
+	action->SetArgumentValue("Value", NPT_String::FromInteger(m_rendererStatus.mute()));
 
 	return NPT_SUCCESS;
 }
@@ -1125,6 +2401,8 @@ void MyOHPlaylist::RendererChanges(SynchronizedStatus* status)
 
 	PLT_Service* service = NULL;
 
+	m_rendererStatus.update(status);
+
 	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Volume:1", service))) {
 		service->PauseEventing(true);
 
@@ -1149,27 +2427,39 @@ void MyOHPlaylist::RendererChanges(SynchronizedStatus* status)
  */
 void MyOHPlaylist::OnMsgPlayNext(MyMessage* arg)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 
 	arg = arg;
 
-	if (m_renderer->getShuffle() && (m_index != -1)) {
+	if (m_settlePending) {
+		/* the skipped track ended, the pending settlePlay() starts the current */
+		return;
+	}
+
+	if (m_rendererStatus.repeat() && (m_index != -1)) {
+		/* looping, the track which just ended is played again next cycle */
+		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
+
+		MyTrackCache::instance().admit(item->uri.empty() ? item->ohPltURI : item->uri);
+	}
+
+	if (m_rendererStatus.shuffle() && (m_index != -1)) {
 		/* create random between 0 ... (m_mediaItems.size() - 1) */
 		m_index = rand() % m_mediaItems.size();
 	}
 
-	if ((m_index != -1) && (m_renderer->getRepeat() || (m_index < ((int)m_mediaItems.size() - 1)))) {
+	if ((m_index != -1) && (m_rendererStatus.repeat() || (m_index < ((int)m_mediaItems.size() - 1)))) {
 		m_index++;
 
 		m_index = (m_index % m_mediaItems.size());
 
 		ML_LOG_DEBUG("next index to play [%d]\n", m_index);
 
-		std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-		m_renderer->play(this, item);
+		std::shared_ptr<MediaItem> item = currentItem();
+		m_renderer->play(this, cachedItem(item));
 
 		m_trackCount++;
-		m_testTime = 0;
+		m_clock.reset();
 
 		UpdateState();
 	}
@@ -1178,7 +2468,7 @@ void MyOHPlaylist::OnMsgPlayNext(MyMessage* arg)
 		m_renderer->stop(this);
 
 		m_index = -1;
-		m_testTime = 0;
+		m_clock.reset();
 
 		UpdateState();
 	}
@@ -1191,28 +2481,40 @@ void MyOHPlaylist::OnMsgUpdatePlayTime(MyMessage* arg)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	UpdatePlayTimeMessage* msg = (UpdatePlayTimeMessage*)arg;
 	PLT_Service* serviceTime = NULL;
 	PLT_Service* serviceInfo = NULL;
+	bool durationChanged = false;
 
-	m_testTime = msg->getTime();
+	/* ticks only correct the drift of the play clock, nothing to do while paused/stopped */
+	if (m_settlePending || !m_clock.correct(msg->getTime()) || (m_index == -1)) {
+		return;
+	}
 
-	if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Time:1", serviceTime))) {
-		serviceTime->PauseEventing(true);
+	/* we do not get always the duration from metadata (KAZOO issue) */
+	if (rendererDuration(m_mediaItems[m_index], msg->getDuration())) {
+		durationChanged = true;
 
-		if (m_index != -1) {
-			serviceTime->SetStateVariable("Seconds", NPT_String::FromInteger(m_testTime));
+		if (!m_subscriptions.hasSubscribers("urn:av-openhome-org:service:Info:1")) {
+			m_infoDirty = true;
+		}
+		else if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Info:1", serviceInfo))) {
+			serviceInfo->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
+		}
+	}
 
-			/* we do not get always the duration from metadata (KAZOO issue) */
-			if (m_mediaItems[m_index]->duration == 0) {
-				m_mediaItems[m_index]->duration = msg->getDuration();
-				serviceTime->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
+	if (!m_subscriptions.hasSubscribers("urn:av-openhome-org:service:Time:1")) {
+		m_timeDirty = true;
+		m_lazySkipped++;
+	}
+	else if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Time:1", serviceTime))) {
+		serviceTime->PauseEventing(true);
 
-				if (NPT_SUCCEEDED(FindServiceByType("urn:av-openhome-org:service:Info:1", serviceInfo))) {
-					serviceInfo->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
-				}
-			}
+		serviceTime->SetStateVariable("Seconds", NPT_String::FromInteger(m_clock.seconds()));
+
+		if (durationChanged) {
+			serviceTime->SetStateVariable("Duration", NPT_String::FromInteger(m_mediaItems[m_index]->duration));
 		}
 
 		serviceTime->PauseEventing(false);
@@ -1230,8 +2532,13 @@ void MyOHPlaylist::MessageListener(MyMessage * arg)
 		ML_LOG_DEBUG(" got message %s\n", MessageIDs::toString(arg->getMessageID()));
 
 		switch(arg->getMessageID()) {
-			case MessageIDs::UpdateState:
+			case MessageIDs::UpdateState: {
+				/* transitions of the renderer itself (end of track, errors) start/stop the clock too */
+				MY_LOCK_GUARD(lock, m_mutex);
+
+				m_clock.setRunning(!m_settlePaused && (m_rendererStatus.refreshState() == RendererState::Playing));
 				break;
+			}
 			case MessageIDs::PlayNext:
 				OnMsgPlayNext(arg);
 				break;
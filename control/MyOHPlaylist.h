@@ -10,12 +10,22 @@
  */
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+
 /* Platinum/Neptune UPnP SDK includes */
 #include <Neptune.h>
 #include <PltOHPlaylist.h>
 #include <PltService.h>
 /* local includes */
 #include <MyPLTController.h>
+#include <MyDidlCodec.h>
+
+#define ID_ARRAY_TOKEN_HISTORY		16	/* tokens remembered for IdArrayChanged */
+#define PLAY_SETTLE					250	/* ms after the last skip before the track is started */
+#define PLAY_SETTLE_SLOT			1	/* MyScheduler slot of the controller */
 
 /**
  *
@@ -23,6 +33,15 @@
 class MyOHPlaylist : public IMyPLTController, public PLT_OHPlaylist
 {
 	public:
+		/**
+		 * What Insert does with a URI already queued.
+		 */
+		enum class DedupMode {
+			Off,		/* queue it again						*/
+			Reject,		/* fail with 802 "Duplicate track"		*/
+			Collapse,	/* keep the queued one, return its id	*/
+		};
+
 		MyOHPlaylist(std::shared_ptr<IRenderer> renderer, void* ctx ,const char* friendly_name,
 					 bool show_ip = false, const char* uuid = NULL,
 					 unsigned int port = 0);
@@ -39,11 +58,62 @@ class MyOHPlaylist : public IMyPLTController, public PLT_OHPlaylist
 		 */
 		virtual void RendererChanges(SynchronizedStatus* status);
 
+		/**
+		 * Memory budget in bytes for the plain DIDL meta data of the
+		 * queued tracks. If exceeded, the meta data of cold items (all
+		 * but the current one) is kept packed. 0 disables it (default).
+		 */
+		void setMetadataBudget(size_t bytes);
+
+		/**
+		 * Limits the playlist to tracksMax tracks (published as TracksMax)
+		 * and bytesMax bytes, inserts beyond fail with 801. 0 is unlimited,
+		 * the default for both.
+		 */
+		void setPlaylistLimits(size_t tracksMax, size_t bytesMax);
+
+		void setDedupMode(DedupMode mode);
+
+		/**
+		 * Logs the memory/CPU tradeoff of the meta data compression.
+		 */
+		void dumpMetadataStats();
+
+		/**
+		 * Number of threads parsing DIDL of bulk loads (1 ... 8).
+		 */
+		void setParserThreads(unsigned int threads);
+
+		/**
+		 * Logs how often Info/Time state was computed and deferred.
+		 */
+		void dumpStateStats();
+
+		/**
+		 * Logs skips (Next/Previous/SeekId/SeekIndex) vs. tracks started.
+		 */
+		void dumpSkipStats();
+
+		/**
+		 * Logs IdArray reads and IdArrayChanged answers.
+		 */
+		void dumpIdArrayStats();
+
+		/**
+		 * Logs lock free playlist reads (IdArray, ReadList) vs. snapshots
+		 * published. Status queries are counted by dumpRendererStatus().
+		 */
+		void dumpSnapshotStats();
+
 	private:
 		/**
 		 * inherent functions from PLT_MediaRenderer class
 		 */
 		virtual NPT_Result SetupServices();
+		virtual NPT_Result OnAction(PLT_ActionReference& action, const PLT_HttpRequestContext& context);
+		virtual NPT_Result ProcessHttpSubscriberRequest(NPT_HttpRequest& request,
+														const NPT_HttpRequestContext& context,
+														NPT_HttpResponse& response);
 
 		/* OH Playlist */
 		virtual NPT_Result OnPlaylistInsert(PLT_ActionReference& action);
@@ -76,9 +146,42 @@ class MyOHPlaylist : public IMyPLTController, public PLT_OHPlaylist
 	    virtual NPT_Result OnPlaylistSetMute(PLT_ActionReference& action);
 	    virtual NPT_Result OnPlaylistMute(PLT_ActionReference& action);
 
+	    NPT_Result OnPlaylistIdArrayChanged(PLT_ActionReference& action);
+
+	    /* vendor extension */
+	    NPT_Result OnPlaylistInsertBatch(PLT_ActionReference& action);
+	    NPT_Result OnPlaylistReadRange(PLT_ActionReference& action);
+	    NPT_Result OnPlaylistCompactDuplicates(PLT_ActionReference& action);
+
 	    /* helper functions */
 		void createIdArray(NPT_String& idArray);
+		void advanceIdArray();
+		void publishIdArray();
 		void UpdateState();
+		void UpdateInfoState();
+		void UpdateTimeState();
+		void RefreshLazyState(const NPT_String& serviceType);
+		void settlePlay();
+		bool cancelSettle();
+		void publishSnapshot(bool quiesce = false);
+
+		std::shared_ptr<MediaItem> createPlaylistItem(const NPT_String& uri, const NPT_String& meta, bool& playable);
+		bool findInsertPosition(int afterId, MediaItemsIt& it);
+		int insertItems(MediaItemsIt it, MediaItems& items);
+		void appendEntry(NPT_String& xml, const std::shared_ptr<MediaItem>& item, bool metadata);
+
+		std::shared_ptr<MediaItem> currentItem();
+		void accountItem(const std::shared_ptr<MediaItem>& item, bool add);
+		void accountMetadata(const std::shared_ptr<MediaItem>& item, bool add);
+		size_t usedBytes();
+		bool admitItems(const MediaItems& items);
+		void indexUri(const std::shared_ptr<MediaItem>& item, bool add);
+		int findDuplicate(const std::shared_ptr<MediaItem>& item);
+		bool filterDuplicates(MediaItems& items);
+		void packMetadata(const std::shared_ptr<MediaItem>& item);
+		void unpackMetadata(const std::shared_ptr<MediaItem>& item);
+		void readMetadata(const std::shared_ptr<MediaItem>& item, std::string& didl);
+		void trimMetadata();
 
 		void OnMsgPlayNext(MyMessage* arg);
 		void OnMsgUpdatePlayTime(MyMessage* arg);
@@ -89,10 +192,64 @@ class MyOHPlaylist : public IMyPLTController, public PLT_OHPlaylist
 		virtual void MessageListener(MyMessage* arg);
 
 	private:
+		struct TokenHistoryEntry {
+			TokenHistoryEntry(int t = 0, const NPT_String& a = "") : token(t), hash(std::hash<std::string>()(a.GetChars())), idArray(a) {}
+
+			int token;
+			size_t hash;		/* of idArray, cheap first compare */
+			NPT_String idArray;	/* the IdArray this token stands for */
+		};
+
+		/**
+		 * Immutable state read by the query actions without lock (RCU),
+		 * writers publish a new one with std::atomic_store.
+		 */
+		struct PlaylistSnapshot {
+			int token;
+			NPT_String idArray;
+			MediaItems items;		/* ohPltID/ohPltURI don't change after insert */
+			bool metadataStable;	/* nothing is packed/unpacked in place, ohPltMetadata may be read too */
+		};
+
+		std::shared_ptr<PlaylistSnapshot> currentSnapshot();
+
 		void* m_context;
 		std::string m_room;
 		int m_id;
 		int m_trackCount;
 		int m_token;
 		NPT_String m_idArray;
+		size_t m_metadataBudget;
+		size_t m_tracksMax;
+		NPT_String m_sdkTracksMax;	/* TracksMax published while unlimited */
+		size_t m_bytesMax;
+		size_t m_itemBytes;			/* items, URIs and MetaData without the DIDL */
+		std::unordered_map<int, size_t> m_itemBytesById;	/* ohPltID -> bytes accounted */
+		DedupMode m_dedupMode;
+		std::unordered_multimap<std::string, int> m_uriIndex; /* normalized ohPltURI -> ohPltID */
+		size_t m_uriIndexBytes;		/* keys and nodes of m_uriIndex */
+		unsigned long m_duplicatesRejected;
+		unsigned long m_duplicatesCollapsed;
+		unsigned long m_duplicatesCompacted;
+		MyDidlStats m_didlStats;
+		std::weak_ptr<MediaItem> m_activeItem; /* item with unpacked meta data */
+		std::atomic<unsigned int> m_parserThreads;
+		bool m_infoDirty;			/* Info state deferred, nobody subscribed */
+		bool m_timeDirty;			/* Time state deferred, nobody subscribed */
+		unsigned long m_lazyComputed;
+		unsigned long m_lazySkipped;
+		int64_t m_lazyMicros;
+		std::array<TokenHistoryEntry, ID_ARRAY_TOKEN_HISTORY> m_tokenHistory;
+		std::atomic<unsigned long> m_idArrayReads;
+		unsigned long m_idArrayChangedCalls;
+		unsigned long m_idArrayUnchanged;
+		bool m_settlePending;		/* skipped, current track not started yet */
+		bool m_settlePaused;		/* paused in the settle window, Play starts the current track */
+		unsigned long m_skips;
+		unsigned long m_skipPlays;
+		std::shared_ptr<PlaylistSnapshot> m_snapshot;	/* std::atomic_load/store */
+		std::atomic<bool> m_snapshotDirty;				/* changed since the last publish */
+		unsigned long m_snapshotPublishes;
+		std::atomic<unsigned long> m_snapshotReads;		/* IdArray and ReadList only */
+		std::atomic<unsigned long> m_snapshotFallbacks;	/* ReadList with packed meta data */
 };
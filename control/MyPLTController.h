@@ -15,6 +15,19 @@
 #include <mutex>
 #include <MediaItem.h>
 #include <MyMessages.h>
+#include <MyArena.h>
+#include <MyDidlReducer.h>
+#include <MyDurationProber.h>
+#include <MyPlayClock.h>
+#include <MyProfiledMutex.h>
+#include <MyProtocolInfo.h>
+#include <MyReclaimer.h>
+#include <MyRendererStatus.h>
+#include <MySubscriptions.h>
+#include <MyScheduler.h>
+#include <MySeekDebouncer.h>
+#include <MyTrackCache.h>
+#include <MyVolumeCoalescer.h>
 
 #define UPNP_MEDIARENDERER_STRING_LEN		20
 
@@ -120,8 +133,11 @@ class IMyPLTController : public MyMessageDispatcher
 		IMyPLTController(std::shared_ptr<IRenderer> renderer)
 			:
 			m_index(-1),
-			m_testTime(0),
-			m_renderer(renderer)
+			m_renderer(renderer),
+			m_rendererStatus(renderer),
+			m_arena(std::make_shared<MyArena>()),
+			m_volume(renderer, this, m_mutex),
+			m_seek(renderer, this, m_mutex)
 		{
 
 		}
@@ -146,6 +162,112 @@ class IMyPLTController : public MyMessageDispatcher
 			}
 		}
 
+		/**
+		 * Logs the usage of the media item arena.
+		 */
+		void dumpArenaStats()
+		{
+			m_arena->dumpStats(getName());
+		}
+
+		/**
+		 * Logs the subscribers per quirk profile.
+		 */
+		void dumpSubscriptions()
+		{
+			m_subscriptions.dump(getName());
+		}
+
+		/**
+		 * Enables/disables the reduction of evented meta data (default off).
+		 */
+		void setMetadataReduction(bool enabled)
+		{
+			m_didlReducer.setEnabled(enabled);
+		}
+
+		/**
+		 * Logs the byte sizes of evented meta data before/after reduction.
+		 */
+		void dumpMetadataReduction()
+		{
+			m_didlReducer.dump(getName());
+		}
+
+		/**
+		 * Ramps volume changes in steps of at most step (0 = jump).
+		 */
+		void setVolumeRamp(int step)
+		{
+			m_volume.setRamp(step);
+		}
+
+		/**
+		 * Logs volume commands received vs. applied to the renderer.
+		 */
+		void dumpVolumeStats()
+		{
+			m_volume.dump(getName());
+		}
+
+		/**
+		 * Logs acquisitions, wait and hold time of m_mutex per lock site.
+		 */
+		void dumpLockStats(bool reset = false)
+		{
+#if defined(MY_MUTEX_PROFILING)
+			m_mutex.dump(getName(), reset);
+#else
+			(void)reset;
+#endif
+		}
+
+		/**
+		 * Logs status reads served by the cache vs. the renderer.
+		 */
+		void dumpRendererStatus()
+		{
+			m_rendererStatus.dump(getName());
+		}
+
+		/**
+		 * Logs renderer ticks and drift corrections of the play position.
+		 */
+		void dumpPlayClock()
+		{
+			MY_LOCK_GUARD(lock, m_mutex);
+
+			m_clock.dump(getName());
+		}
+
+		/**
+		 * Logs seeks issued by CPs vs. executed by the renderer.
+		 */
+		void dumpSeekStats()
+		{
+			m_seek.dump(getName());
+		}
+
+		/**
+		 * Item of the current track, nullptr if none. Lock must be held.
+		 */
+		std::shared_ptr<MediaItem> currentTrack()
+		{
+			return ((m_index >= 0) && (m_index < (int)m_mediaItems.size())) ? m_mediaItems[m_index] : nullptr;
+		}
+
+		/**
+		 * Resource selection of this room (bitrate/sample rate caps,
+		 * preferred codecs), NULL selects by protocol info only.
+		 * Applies to tracks queued afterwards.
+		 */
+		void setResourcePolicy(MyResourcePolicyPtr policy)
+		{
+			std::atomic_store(&m_resourcePolicy, policy);
+
+			m_didlReducer.setResourcePolicy(policy);
+		}
+
 	private:
 		virtual int messageListener(MyMessage* arg)
 		{
@@ -154,9 +276,131 @@ class IMyPLTController : public MyMessageDispatcher
 		}
 
 	protected:
+		/**
+		 * Media items are allocated from the playlist arena, the item
+		 * keeps the arena alive until it's released.
+		 */
+		std::shared_ptr<MediaItem> createMediaItem()
+		{
+			return std::allocate_shared<MediaItem>(MyArenaAllocator<MediaItem>(m_arena));
+		}
+
+		/**
+		 * Drops the deferred commands (volume, ...) of this controller,
+		 * must be called first thing in the destructor of derived classes.
+		 */
+		void cancelDeferred()
+		{
+			m_volume.cancel();
+			m_seek.cancel();
+			MyScheduler::instance().cancelAll(this);
+		}
+
+		/**
+		 * Orders the resources of object for this room, see MyProtocolInfo.
+		 */
+		bool selectResources(PLT_MediaObject* object)
+		{
+			MyResourcePolicyPtr policy = std::atomic_load(&m_resourcePolicy);
+
+			return MyProtocolInfo::sink().selectResources(object, policy.get());
+		}
+
+		/**
+		 * Takes the probed duration of an item without one, or queues
+		 * it for probing. Returns true if the duration was set.
+		 */
+		bool probeDuration(const std::shared_ptr<MediaItem>& item)
+		{
+			const std::string& uri = item->uri.empty() ? item->ohPltURI : item->uri;
+			int seconds;
+
+			if (item->duration != 0) {
+				return false;
+			}
+
+			if (MyDurationProber::instance().lookup(uri, seconds)) {
+				item->duration = seconds;
+				return true;
+			}
+
+			MyDurationProber::instance().probe(uri);
+
+			return false;
+		}
+
+		/**
+		 * Item to hand to the renderer: a copy pointing at the local
+		 * file if the track is in the MyTrackCache, item otherwise.
+		 * The playlist keeps the original.
+		 */
+		std::shared_ptr<MediaItem> cachedItem(const std::shared_ptr<MediaItem>& item)
+		{
+			const std::string& uri = item->uri.empty() ? item->ohPltURI : item->uri;
+			std::string path;
+
+			if (!MyTrackCache::instance().lookup(uri, path)) {
+				return item;
+			}
+
+			std::shared_ptr<MediaItem> cached = std::make_shared<MediaItem>(*item);
+
+			cached->uri = "file://" + path;
+
+			return cached;
+		}
+
+		/**
+		 * Duration reported by the renderer for the current item. It
+		 * fills in a missing duration and replaces a probed one, the
+		 * probe is only a guess until the decoder knows. Returns true
+		 * if the duration of the item was (re)set.
+		 */
+		bool rendererDuration(const std::shared_ptr<MediaItem>& item, int duration)
+		{
+			const std::string& uri = item->uri.empty() ? item->ohPltURI : item->uri;
+			int seconds;
+
+			if (item->duration == 0) {
+				if (!probeDuration(item)) {
+					item->duration = duration;
+				}
+
+				return true;
+			}
+
+			if ((duration > 0) && (duration != item->duration) &&
+				MyDurationProber::instance().lookup(uri, seconds) && (seconds == item->duration)) {
+				item->duration = duration;
+				return true;
+			}
+
+			return false;
+		}
+
+		/**
+		 * Swaps in an empty playlist in constant time, the old one is
+		 * released by the low priority reclaimer thread.
+		 */
+		void clearMediaItems()
+		{
+			MediaItems items;
+
+			items.swap(m_mediaItems);
+
+			MyReclaimer::instance().reclaim(items);
+		}
+
 		int m_index; /* track index in m_mediaItems */
 		MediaItems m_mediaItems;
-		int m_testTime;
+		MyPlayClock m_clock; /* play position, extrapolated between renderer ticks */
 		std::shared_ptr<IRenderer> m_renderer;
-		std::mutex m_mutex;
+		MyRendererStatus m_rendererStatus; /* handlers read the status here, not from m_renderer */
+		MyControllerMutex m_mutex; /* std::mutex unless built with MY_MUTEX_PROFILING */
+		std::shared_ptr<MyArena> m_arena;
+		MySubscriptions m_subscriptions;
+		MyDidlReducer m_didlReducer;
+		MyResourcePolicyPtr m_resourcePolicy; /* accessed with std::atomic_load/store, DIDL is parsed without lock */
+		MyVolumeCoalescer m_volume;
+		MySeekDebouncer m_seek;
 };
@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#include "MyParallel.h"
+
+/**
+ *
+ */
+MyParallelPool& MyParallelPool::instance()
+{
+	static MyParallelPool s_pool;
+
+	return s_pool;
+}
+
+/**
+ *
+ */
+MyParallelPool::MyParallelPool()
+	:
+	m_work(nullptr),
+	m_tickets(0),
+	m_active(0),
+	m_stop(false)
+{
+
+}
+
+/**
+ *
+ */
+MyParallelPool::~MyParallelPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_wake.notify_all();
+
+	for (auto& t : m_threads) {
+		if (t.joinable()) {
+			t.join();
+		}
+	}
+}
+
+/**
+ *
+ */
+void MyParallelPool::run(unsigned int helpers, const std::function<void()>& work)
+{
+	std::unique_lock<std::mutex> busy(m_busy, std::try_to_lock);
+
+	/* pool in use by another caller */
+	if (!busy.owns_lock()) {
+		work();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		while (m_threads.size() < helpers) {
+			m_threads.push_back(std::thread(&MyParallelPool::loop, this));
+		}
+
+		m_work = &work;
+		m_tickets = helpers;
+	}
+
+	m_wake.notify_all();
+
+	work();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	/* all indices are handed out, helpers not yet awake aren't needed */
+	m_tickets = 0;
+
+	m_done.wait(lock, [this]() { return m_active == 0; });
+
+	m_work = nullptr;
+}
+
+/**
+ *
+ */
+void MyParallelPool::loop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true) {
+		m_wake.wait(lock, [this]() { return m_stop || (m_tickets > 0); });
+
+		if (m_stop) {
+			break;
+		}
+
+		const std::function<void()>* work = m_work;
+
+		m_tickets--;
+		m_active++;
+
+		lock.unlock();
+
+		(*work)();
+
+		lock.lock();
+
+		if (--m_active == 0) {
+			m_done.notify_all();
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define MY_PARALLEL_MAX_THREADS		8
+#define MY_PARALLEL_MIN_PER_THREAD	16	/* fewer indices per thread run serially	*/
+
+/**
+ * Number of worker threads to use by default (1 ... MY_PARALLEL_MAX_THREADS).
+ */
+inline unsigned int my_parallel_default_threads()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+
+	return std::max(1u, std::min(cores, (unsigned int)MY_PARALLEL_MAX_THREADS));
+}
+
+/**
+ * Small persistent pool behind my_parallel_for(). Threads are started
+ * on first use and then kept, so a bulk load doesn't pay for thread
+ * creation every time. Only one caller uses the pool at a time, a
+ * concurrent caller runs its work on its own thread.
+ */
+class MyParallelPool
+{
+	public:
+		static MyParallelPool& instance();
+
+		/**
+		 * Runs work on the calling thread and on up to helpers pool
+		 * threads, returns when all of them are done.
+		 */
+		void run(unsigned int helpers, const std::function<void()>& work);
+
+	private:
+		MyParallelPool();
+		~MyParallelPool();
+
+		void loop();
+
+		std::mutex m_busy;
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		std::vector<std::thread> m_threads;
+		const std::function<void()>* m_work;
+		unsigned int m_tickets;
+		unsigned int m_active;
+		bool m_stop;
+};
+
+/**
+ * Calls fn(i) for every i in [0, count) on up to threads threads,
+ * the calling thread takes part. Indices are handed out one by one,
+ * so uneven work (e.g. DIDL of different size) is balanced. Small
+ * counts run serially. Returns when all calls are done. fn must not
+ * throw.
+ */
+template <typename Fn>
+void my_parallel_for(size_t count, unsigned int threads, Fn fn)
+{
+	std::atomic<size_t> next(0);
+
+	std::function<void()> worker = [&]() {
+		for (size_t i = next++; i < count; i = next++) {
+			fn(i);
+		}
+	};
+
+	threads = std::max(1u, std::min(threads, (unsigned int)MY_PARALLEL_MAX_THREADS));
+
+	if (threads > count / MY_PARALLEL_MIN_PER_THREAD) {
+		threads = std::max((size_t)1, count / MY_PARALLEL_MIN_PER_THREAD);
+	}
+
+	if (threads == 1) {
+		worker();
+		return;
+	}
+
+	MyParallelPool::instance().run(threads - 1, worker);
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <math.h>
+
+/* local includes */
+#include "MyPlayClock.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MyPlayClock::MyPlayClock()
+	:
+	m_anchorTime(std::chrono::steady_clock::now()),
+	m_anchorPosition(0),
+	m_running(false),
+	m_ticks(0),
+	m_ticksIgnored(0),
+	m_corrections(0),
+	m_maxDrift(0)
+{
+
+}
+
+/**
+ *
+ */
+void MyPlayClock::reset()
+{
+	m_running = false;
+
+	anchor(0);
+}
+
+/**
+ *
+ */
+void MyPlayClock::setRunning(bool running)
+{
+	if (running != m_running) {
+		anchor(position());
+		m_running = running;
+	}
+}
+
+/**
+ *
+ */
+int MyPlayClock::seconds() const
+{
+	return (int)position();
+}
+
+/**
+ *
+ */
+bool MyPlayClock::correct(int seconds)
+{
+	double drift = seconds - position();
+
+	m_ticks++;
+
+	if (!m_running && (fabs(drift) < PLAY_CLOCK_DRIFT)) {
+		m_ticksIgnored++;
+		return false;
+	}
+
+	/* ticks come with whole seconds, only a real jump (seek, stall) re-anchors */
+	if (fabs(drift) >= PLAY_CLOCK_DRIFT) {
+		if (m_running && (fabs(drift) > m_maxDrift)) {
+			m_maxDrift = fabs(drift);
+		}
+
+		anchor(seconds);
+		m_corrections++;
+	}
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyPlayClock::dump(const char* name)
+{
+	ML_LOG_DEBUG("%s play clock ticks [%lu] ignored [%lu] corrections [%lu] max drift [%.1f s]\n",
+				 name, m_ticks, m_ticksIgnored, m_corrections, m_maxDrift);
+}
+
+/**
+ *
+ */
+double MyPlayClock::position() const
+{
+	if (!m_running) {
+		return m_anchorPosition;
+	}
+
+	return m_anchorPosition + std::chrono::duration<double>(std::chrono::steady_clock::now() - m_anchorTime).count();
+}
+
+/**
+ *
+ */
+void MyPlayClock::anchor(double position)
+{
+	m_anchorPosition = position;
+	m_anchorTime = std::chrono::steady_clock::now();
+}
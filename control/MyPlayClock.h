@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+
+#define PLAY_CLOCK_DRIFT			1.5		/* s, a renderer tick further off re-anchors the clock */
+
+/**
+ * Play position extrapolated from an anchor (position and monotonic
+ * time of the last state change) instead of taken from every renderer
+ * tick, so Seconds/RelativeTimePosition are computed on demand and
+ * ticks are only needed for drift correction. Not thread safe, used
+ * with the lock of the controller held.
+ */
+class MyPlayClock
+{
+	public:
+		MyPlayClock();
+
+		/**
+		 * New track or stop, position 0 and not running.
+		 */
+		void reset();
+
+		/**
+		 * Renderer started/stopped playing, the position is kept.
+		 */
+		void setRunning(bool running);
+		bool running() const { return m_running; }
+
+		/**
+		 * Position in whole seconds.
+		 */
+		int seconds() const;
+
+		/**
+		 * Renderer tick. Returns false if it changes nothing, i.e. it
+		 * came while not running and matches the frozen position.
+		 */
+		bool correct(int seconds);
+
+		void dump(const char* name);
+
+	private:
+		double position() const;
+		void anchor(double position);
+
+	private:
+		std::chrono::steady_clock::time_point m_anchorTime;
+		double m_anchorPosition;
+		bool m_running;
+		unsigned long m_ticks;
+		unsigned long m_ticksIgnored;		/* while paused/stopped */
+		unsigned long m_corrections;
+		double m_maxDrift;
+};
@@ -0,0 +1,61 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+
+/**
+ * SCPD of the vendor playlist extension, only used by our own control points.
+ */
+NPT_UInt8 MY_PlaylistExtSCPD[] =
+	"<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+	"<scpd xmlns=\"urn:schemas-upnp-org:service-1-0\">"
+		"<specVersion><major>1</major><minor>0</minor></specVersion>"
+		"<actionList>"
+			"<action>"
+				"<name>InsertBatch</name>"
+				"<argumentList>"
+					"<argument><name>AfterId</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_Id</relatedStateVariable></argument>"
+					"<argument><name>Entries</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_TrackList</relatedStateVariable></argument>"
+					"<argument><name>FirstId</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Id</relatedStateVariable></argument>"
+					"<argument><name>LastId</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Id</relatedStateVariable></argument>"
+				"</argumentList>"
+			"</action>"
+			"<action>"
+				"<name>ReadRange</name>"
+				"<argumentList>"
+					"<argument><name>StartIndex</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_Index</relatedStateVariable></argument>"
+					"<argument><name>Count</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_Index</relatedStateVariable></argument>"
+					"<argument><name>Token</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_Token</relatedStateVariable></argument>"
+					"<argument><name>Fields</name><direction>in</direction><relatedStateVariable>A_ARG_TYPE_Fields</relatedStateVariable></argument>"
+					"<argument><name>TrackList</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_TrackList</relatedStateVariable></argument>"
+					"<argument><name>NextIndex</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Index</relatedStateVariable></argument>"
+					"<argument><name>Total</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Index</relatedStateVariable></argument>"
+					"<argument><name>CurrentToken</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Token</relatedStateVariable></argument>"
+				"</argumentList>"
+			"</action>"
+			"<action>"
+				"<name>CompactDuplicates</name>"
+				"<argumentList>"
+					"<argument><name>Removed</name><direction>out</direction><relatedStateVariable>A_ARG_TYPE_Index</relatedStateVariable></argument>"
+				"</argumentList>"
+			"</action>"
+		"</actionList>"
+		"<serviceStateTable>"
+			"<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_Id</name><dataType>ui4</dataType></stateVariable>"
+			"<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_TrackList</name><dataType>string</dataType></stateVariable>"
+			"<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_Index</name><dataType>ui4</dataType></stateVariable>"
+			"<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_Token</name><dataType>ui4</dataType></stateVariable>"
+			"<stateVariable sendEvents=\"no\"><name>A_ARG_TYPE_Fields</name><dataType>string</dataType>"
+				"<allowedValueList><allowedValue>IdUri</allowedValue><allowedValue>All</allowedValue></allowedValueList>"
+			"</stateVariable>"
+		"</serviceStateTable>"
+	"</scpd>";
@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <algorithm>
+#include <vector>
+
+/* local includes */
+#include "MyProfiledMutex.h"
+#include "MyLogger.h"
+
+#if defined(MY_MUTEX_PROFILING)
+
+/**
+ *
+ */
+MyProfiledMutex::MyProfiledMutex()
+	:
+	m_site(NULL)
+{
+
+}
+
+/**
+ *
+ */
+void MyProfiledMutex::lock(const char* site)
+{
+	if (m_mutex.try_lock()) {
+		acquired(site, -1);
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	m_mutex.lock();
+
+	acquired(site, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ *
+ */
+bool MyProfiledMutex::try_lock()
+{
+	if (!m_mutex.try_lock()) {
+		return false;
+	}
+
+	acquired(NULL, -1);
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyProfiledMutex::unlock()
+{
+	int64_t holdNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_acquired).count();
+	const char* site = m_site;
+
+	m_mutex.unlock();
+
+	std::lock_guard<std::mutex> lock(m_statsMutex);
+	Site& s = m_sites[site];
+
+	s.holdNs += holdNs;
+	s.maxHoldNs = std::max(s.maxHoldNs, holdNs);
+}
+
+/**
+ *
+ */
+void MyProfiledMutex::dump(const char* name, bool reset)
+{
+	std::vector<std::pair<const char*, Site> > sites;
+
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+
+		sites.assign(m_sites.begin(), m_sites.end());
+
+		if (reset) {
+			m_sites.clear();
+		}
+	}
+
+	std::sort(sites.begin(), sites.end(), [](const std::pair<const char*, Site>& a, const std::pair<const char*, Site>& b) {
+		return a.second.waitNs > b.second.waitNs;
+	});
+
+	for (auto& i : sites) {
+		const Site& s = i.second;
+
+		ML_LOG_DEBUG("%s lock %s count [%lu] contended [%lu] wait avg/max [%.1f/%.1f us] hold avg/max [%.1f/%.1f us]\n",
+					 name, i.first ? i.first : "(unattributed)", s.count, s.contended,
+					 s.count ? s.waitNs / 1000.0 / s.count : 0.0, s.maxWaitNs / 1000.0,
+					 s.count ? s.holdNs / 1000.0 / s.count : 0.0, s.maxHoldNs / 1000.0);
+	}
+}
+
+/**
+ * Holder only, waitNs -1 if it wasn't contended.
+ */
+void MyProfiledMutex::acquired(const char* site, int64_t waitNs)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_statsMutex);
+		Site& s = m_sites[site];
+
+		s.count++;
+
+		if (waitNs >= 0) {
+			s.contended++;
+			s.waitNs += waitNs;
+			s.maxWaitNs = std::max(s.maxWaitNs, waitNs);
+		}
+	}
+
+	m_site = site;
+	m_acquired = std::chrono::steady_clock::now();
+}
+
+#endif
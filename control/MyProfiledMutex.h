@@ -0,0 +1,108 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <mutex>
+
+/**
+ * Contention profiling of the controller mutex, enabled at compile time
+ * with -DMY_MUTEX_PROFILING. Without it MyControllerMutex is std::mutex
+ * and MY_LOCK_GUARD a std::lock_guard, no overhead at all.
+ *
+ * Lock sites use MY_LOCK_GUARD(name, mutex) instead of std::lock_guard,
+ * acquisitions, wait and hold time are recorded per file:line. Locks
+ * taken through std::unique_lock/std::lock_guard count as unattributed.
+ */
+#if defined(MY_MUTEX_PROFILING)
+
+#include <chrono>
+#include <map>
+#include <stdint.h>
+
+#define MY_LOCK_STRINGIFY_(x)	#x
+#define MY_LOCK_STRINGIFY(x)	MY_LOCK_STRINGIFY_(x)
+#define MY_LOCK_SITE			__FILE__ ":" MY_LOCK_STRINGIFY(__LINE__)
+
+/**
+ * Drop in for std::mutex (Lockable) recording per site statistics.
+ */
+class MyProfiledMutex
+{
+	public:
+		MyProfiledMutex();
+
+		/**
+		 * site must be a string literal (MY_LOCK_SITE), NULL is unattributed.
+		 */
+		void lock(const char* site = NULL);
+		bool try_lock();
+		void unlock();
+
+		/**
+		 * Logs the sites by total wait time, reset clears the counters.
+		 */
+		void dump(const char* name, bool reset = false);
+
+	private:
+		MyProfiledMutex(const MyProfiledMutex&);
+		MyProfiledMutex& operator=(const MyProfiledMutex&);
+
+		void acquired(const char* site, int64_t waitNs);
+
+	private:
+		struct Site {
+			Site() : count(0), contended(0), waitNs(0), maxWaitNs(0), holdNs(0), maxHoldNs(0) {}
+
+			unsigned long count;
+			unsigned long contended;	/* had to wait */
+			int64_t waitNs;
+			int64_t maxWaitNs;
+			int64_t holdNs;
+			int64_t maxHoldNs;
+		};
+
+		std::mutex m_mutex;
+		std::mutex m_statsMutex;
+		std::map<const char*, Site> m_sites;	/* by literal, the address is unique per site */
+		/* written by the holder only */
+		const char* m_site;
+		std::chrono::steady_clock::time_point m_acquired;
+};
+
+/**
+ *
+ */
+template<class Mutex>
+class MyLockGuard
+{
+	public:
+		MyLockGuard(Mutex& mutex, const char* site) : m_mutex(mutex) { m_mutex.lock(site); }
+		~MyLockGuard() { m_mutex.unlock(); }
+
+	private:
+		MyLockGuard(const MyLockGuard&);
+		MyLockGuard& operator=(const MyLockGuard&);
+
+	private:
+		Mutex& m_mutex;
+};
+
+typedef MyProfiledMutex MyControllerMutex;
+
+#define MY_LOCK_GUARD(name, lockable)	MyLockGuard<MyProfiledMutex> name(lockable, MY_LOCK_SITE)
+
+#else
+
+typedef std::mutex MyControllerMutex;
+
+#define MY_LOCK_GUARD(name, lockable)	std::lock_guard<std::mutex> name(lockable)
+
+#endif
@@ -0,0 +1,240 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+/* local includes */
+#include "MyProtocolInfo.h"
+#include "MyPLTController.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+static std::string to_lower(const char* value)
+{
+	std::string lower(value);
+
+	std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+
+	return lower;
+}
+
+/**
+ * Lower case mime without parameters ("audio/L16;rate=44100" is "audio/l16").
+ */
+static std::string to_mime(const char* contentType)
+{
+	std::string mime = to_lower(contentType);
+	size_t end = mime.find(';');
+
+	if (end != std::string::npos) {
+		mime.erase(end);
+	}
+
+	while (!mime.empty() && isspace((unsigned char)mime.back())) {
+		mime.erase(mime.size() - 1);
+	}
+
+	return mime;
+}
+
+/**
+ *
+ */
+MyProtocolInfo& MyProtocolInfo::sink()
+{
+	static MyProtocolInfo instance(RESOURCE_PROTOCOL_INFO_VALUES);
+
+	return instance;
+}
+
+/**
+ *
+ */
+MyProtocolInfo::MyProtocolInfo(const char* values)
+	:
+	m_selections(0),
+	m_resources(0),
+	m_dropped(0),
+	m_unplayable(0),
+	m_overLimit(0),
+	m_micros(0)
+{
+	NPT_List<NPT_String> entries = NPT_String(values).Split(",");
+
+	for (NPT_List<NPT_String>::Iterator it = entries.GetFirstItem(); it; it++) {
+		PLT_ProtocolInfo protocolInfo((*it).GetChars());
+
+		if (!protocolInfo.IsValid()) {
+			continue;
+		}
+
+		Protocol& protocol = m_protocols[to_lower(protocolInfo.GetProtocol())];
+
+		if (protocolInfo.GetContentType().Compare("*") == 0) {
+			protocol.anyMime = true;
+		}
+		else {
+			protocol.mimes.insert(to_mime(protocolInfo.GetContentType()));
+		}
+	}
+}
+
+/**
+ *
+ */
+int MyProtocolInfo::rank(const PLT_ProtocolInfo& protocolInfo) const
+{
+	auto protocol = m_protocols.find(to_lower(protocolInfo.GetProtocol()));
+
+	if (protocol == m_protocols.end()) {
+		return -1;
+	}
+
+	std::string mime = to_mime(protocolInfo.GetContentType());
+
+	/* images are only album art, never the track, even if listed */
+	if (mime.compare(0, 6, "image/") == 0) {
+		return -1;
+	}
+
+	bool listed = protocol->second.mimes.count(mime) > 0;
+
+	if (!listed && !protocol->second.anyMime) {
+		return -1;
+	}
+
+	/* any audio beats video or other containers */
+	if (mime.compare(0, 6, "audio/") == 0) {
+		return listed ? 3 : 2;
+	}
+
+	return listed ? 1 : 0;
+}
+
+/**
+ * Sort key of a playable resource, compared in member order.
+ */
+struct RankedResource
+{
+	int fits;				/* 1 within the policy limits			*/
+	int preferred;			/* higher is a more preferred mime		*/
+	int rank;				/* MyProtocolInfo::rank()				*/
+	NPT_UInt32 bitrate;		/* lower wins first if none fits		*/
+	PLT_MediaItemResource resource;
+
+	/**
+	 * Fitting resources by preferred mime and rank. If none fits the
+	 * lowest bitrate wins, preferred mime and rank only break ties.
+	 */
+	bool operator>(const RankedResource& other) const
+	{
+		if (fits != other.fits) return fits > other.fits;
+		if (!fits && (bitrate != other.bitrate)) return bitrate < other.bitrate;
+		if (preferred != other.preferred) return preferred > other.preferred;
+		return rank > other.rank;
+	}
+};
+
+/**
+ *
+ */
+bool MyProtocolInfo::selectResources(PLT_MediaObject* object, const MyResourcePolicy* policy)
+{
+	NPT_Cardinal count = object->m_Resources.GetItemCount();
+	std::vector<RankedResource> ranked;
+
+	if (count == 0) {
+		return true;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	ranked.reserve(count);
+
+	for (NPT_Cardinal i = 0; i < count; i++) {
+		const PLT_MediaItemResource& resource = object->m_Resources[i];
+		RankedResource r;
+
+		r.rank = rank(resource.m_ProtocolInfo);
+
+		if (r.rank < 0) {
+			continue;
+		}
+
+		r.fits = 1;
+		r.preferred = 0;
+		r.bitrate = resource.m_Bitrate;
+		r.resource = resource;
+
+		if (policy) {
+			/* unknown (0) bitrate or sample rate is taken as fitting */
+			if ((policy->maxBitrate && (resource.m_Bitrate > policy->maxBitrate)) ||
+				(policy->maxSampleRate && (resource.m_SampleFrequency > policy->maxSampleRate))) {
+				r.fits = 0;
+			}
+
+			std::string mime = to_mime(resource.m_ProtocolInfo.GetContentType());
+
+			for (size_t p = 0; p < policy->preferredMimes.size(); p++) {
+				if (policy->preferredMimes[p] == mime) {
+					r.preferred = policy->preferredMimes.size() - p;
+					break;
+				}
+			}
+		}
+
+		ranked.push_back(r);
+	}
+
+	std::stable_sort(ranked.begin(), ranked.end(), [](const RankedResource& a, const RankedResource& b) {
+		return a > b;
+	});
+
+	/* keep the DIDL as is if nothing is playable, the caller decides */
+	if (!ranked.empty()) {
+		object->m_Resources.Clear();
+
+		for (auto& r : ranked) {
+			object->m_Resources.Add(r.resource);
+		}
+
+		if (!ranked[0].fits) {
+			m_overLimit++;
+		}
+	}
+	else {
+		m_unplayable++;
+	}
+
+	m_selections++;
+	m_resources += count;
+	m_dropped += count - ranked.size();
+	m_micros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+	return !ranked.empty();
+}
+
+/**
+ *
+ */
+void MyProtocolInfo::dump(const char* name)
+{
+	unsigned long selections = m_selections;
+
+	ML_LOG_DEBUG("%s protocols [%zu], selections [%lu] avg [%.1f us], resources [%lu] dropped [%lu], unplayable tracks [%lu], over policy limits [%lu]\n",
+				 name, m_protocols.size(), selections, selections ? (double)m_micros / selections : 0.0,
+				 (unsigned long)m_resources, (unsigned long)m_dropped, (unsigned long)m_unplayable, (unsigned long)m_overLimit);
+}
@@ -0,0 +1,94 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+#include <PltMediaItem.h>
+
+/**
+ * Per room limits for the resource selection, e.g. for rooms on weak
+ * Wi-Fi. Resources within the limits win, if none is the one with the
+ * lowest bitrate is taken.
+ */
+struct MyResourcePolicy
+{
+	MyResourcePolicy()
+		:
+		maxBitrate(0),
+		maxSampleRate(0)
+	{
+
+	}
+
+	NPT_UInt32 maxBitrate;						/* bytes/s as DIDL bitrate, 0 = no limit	*/
+	NPT_UInt32 maxSampleRate;					/* Hz, 0 = no limit							*/
+	std::vector<std::string> preferredMimes;	/* lower case, best first					*/
+};
+
+typedef std::shared_ptr<const MyResourcePolicy> MyResourcePolicyPtr;
+
+/**
+ * Lookup structure of the protocol info we advertise as sink
+ * (RESOURCE_PROTOCOL_INFO_VALUES), used to rank the <res> of
+ * incoming DIDL and to refuse tracks we can't play at all.
+ */
+class MyProtocolInfo
+{
+	public:
+		/**
+		 * Index of RESOURCE_PROTOCOL_INFO_VALUES, built once.
+		 */
+		static MyProtocolInfo& sink();
+
+		MyProtocolInfo(const char* values);
+
+		/**
+		 * -1 not playable (images included), 0 listed by wildcard only,
+		 * 1 listed explicitly, 2 audio listed by wildcard only, 3 audio
+		 * listed explicitly. Mime parameters are ignored.
+		 */
+		int rank(const PLT_ProtocolInfo& protocolInfo) const;
+
+		/**
+		 * Orders the resources of object best first (stable) and drops
+		 * the ones not playable. Returns false if object has resources
+		 * but none is playable, an object without any is playable.
+		 * Without policy the order is by rank() only.
+		 */
+		bool selectResources(PLT_MediaObject* object, const MyResourcePolicy* policy = NULL);
+
+		void dump(const char* name);
+
+	private:
+		struct Protocol {
+			Protocol() : anyMime(false) {}
+
+			bool anyMime;						/* proto:*:*:* */
+			std::unordered_set<std::string> mimes;	/* lower case */
+		};
+
+		std::unordered_map<std::string, Protocol> m_protocols;
+
+		std::atomic<unsigned long> m_selections;
+		std::atomic<unsigned long> m_resources;
+		std::atomic<unsigned long> m_dropped;
+		std::atomic<unsigned long> m_unplayable;
+		std::atomic<unsigned long> m_overLimit;		/* best resource was above the policy limits */
+		std::atomic<int64_t> m_micros;
+};
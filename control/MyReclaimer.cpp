@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+
+/* local includes */
+#include "MyReclaimer.h"
+#include "MyLogger.h"
+
+#define RECLAIMER_BATCH_SIZE	256		/* items released before yielding */
+
+/**
+ *
+ */
+MyReclaimer& MyReclaimer::instance()
+{
+	static MyReclaimer s_reclaimer;
+
+	return s_reclaimer;
+}
+
+/**
+ *
+ */
+MyReclaimer::MyReclaimer()
+	:
+	m_stop(false),
+	m_thread(&MyReclaimer::run, this)
+{
+
+}
+
+/**
+ *
+ */
+MyReclaimer::~MyReclaimer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_cond.notify_one();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+/**
+ *
+ */
+void MyReclaimer::reclaim(MediaItems& items)
+{
+	if (items.empty()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_generations.push_back(MediaItems());
+		m_generations.back().swap(items);
+	}
+
+	m_cond.notify_one();
+}
+
+/**
+ *
+ */
+void MyReclaimer::run()
+{
+#if defined(__linux__)
+	/* only use otherwise idle CPU time */
+	struct sched_param param;
+	param.sched_priority = 0;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		m_cond.wait(lock, [this] { return m_stop || !m_generations.empty(); });
+
+		if (m_generations.empty()) {
+			/* stop requested and nothing left */
+			break;
+		}
+
+		MediaItems items;
+		items.swap(m_generations.front());
+		m_generations.pop_front();
+
+		lock.unlock();
+
+		auto start = std::chrono::steady_clock::now();
+		size_t count = items.size();
+
+		while (!items.empty()) {
+			items.pop_back();
+
+			if ((items.size() % RECLAIMER_BATCH_SIZE) == 0) {
+				std::this_thread::yield();
+			}
+		}
+
+		ML_LOG_DEBUG("reclaimed [%zu] items in [%lld] us\n", count,
+					 (long long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+
+		lock.lock();
+	}
+}
@@ -0,0 +1,48 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <MediaItem.h>
+
+/**
+ * Releases dropped playlist generations on a low priority thread,
+ * so clearing a large playlist does not delay the action reply.
+ */
+class MyReclaimer
+{
+	public:
+		static MyReclaimer& instance();
+
+		/**
+		 * Takes over the items in constant time, items is empty afterwards.
+		 */
+		void reclaim(MediaItems& items);
+
+	private:
+		MyReclaimer();
+		~MyReclaimer();
+
+		MyReclaimer(const MyReclaimer&);
+		MyReclaimer& operator=(const MyReclaimer&);
+
+		void run();
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::deque<MediaItems> m_generations;
+		bool m_stop;
+		std::thread m_thread;
+};
@@ -0,0 +1,211 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <algorithm>
+
+/* local includes */
+#include "MyRendererStatus.h"
+#include "Renderer.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MyRendererStatus::MyRendererStatus(std::shared_ptr<IRenderer> renderer)
+	:
+	m_renderer(renderer),
+	m_word(0),
+	m_reads(0),
+	m_fallbacks(0)
+{
+
+}
+
+/**
+ *
+ */
+void MyRendererStatus::refresh()
+{
+	uint32_t bits = (uint32_t)std::min(std::max(m_renderer->getVolume(), 0), (int)kVolumeMask);
+
+	bits |= m_renderer->getMute() ? kMute : 0;
+	bits |= m_renderer->getRepeat() ? kRepeat : 0;
+	bits |= m_renderer->getShuffle() ? kShuffle : 0;
+
+	store(kVolumeMask | kMute | kRepeat | kShuffle | kStatusValid, bits | kStatusValid);
+
+	refreshState();
+}
+
+/**
+ *
+ */
+RendererState MyRendererStatus::refreshState()
+{
+	RendererState state = m_renderer->getState();
+
+	setState(state);
+
+	return state;
+}
+
+/**
+ *
+ */
+void MyRendererStatus::update(const SynchronizedStatus* status)
+{
+	uint32_t bits = (uint32_t)std::min(std::max(status->volume, 0), (int)kVolumeMask);
+
+	bits |= status->mute ? kMute : 0;
+	bits |= status->repeat ? kRepeat : 0;
+	bits |= status->shuffle ? kShuffle : 0;
+
+	store(kVolumeMask | kMute | kRepeat | kShuffle | kStatusValid, bits | kStatusValid);
+}
+
+/**
+ *
+ */
+void MyRendererStatus::setState(RendererState state)
+{
+	store(kStateMask | kStateValid, (((uint32_t)state << kStateShift) & kStateMask) | kStateValid);
+}
+
+/**
+ *
+ */
+void MyRendererStatus::setRepeat(int repeat)
+{
+	store(kRepeat, repeat ? kRepeat : 0);
+}
+
+/**
+ *
+ */
+void MyRendererStatus::setShuffle(int shuffle)
+{
+	store(kShuffle, shuffle ? kShuffle : 0);
+}
+
+/**
+ *
+ */
+void MyRendererStatus::setMute(int mute)
+{
+	store(kMute, mute ? kMute : 0);
+}
+
+/**
+ *
+ */
+RendererState MyRendererStatus::state()
+{
+	uint32_t word;
+
+	if (!load(kStateValid, word)) {
+		return m_renderer->getState();
+	}
+
+	return (RendererState)((word & kStateMask) >> kStateShift);
+}
+
+/**
+ *
+ */
+int MyRendererStatus::volume()
+{
+	uint32_t word;
+
+	if (!load(kStatusValid, word)) {
+		return m_renderer->getVolume();
+	}
+
+	return word & kVolumeMask;
+}
+
+/**
+ *
+ */
+int MyRendererStatus::mute()
+{
+	uint32_t word;
+
+	if (!load(kStatusValid, word)) {
+		return m_renderer->getMute();
+	}
+
+	return (word & kMute) ? 1 : 0;
+}
+
+/**
+ *
+ */
+int MyRendererStatus::repeat()
+{
+	uint32_t word;
+
+	if (!load(kStatusValid, word)) {
+		return m_renderer->getRepeat();
+	}
+
+	return (word & kRepeat) ? 1 : 0;
+}
+
+/**
+ *
+ */
+int MyRendererStatus::shuffle()
+{
+	uint32_t word;
+
+	if (!load(kStatusValid, word)) {
+		return m_renderer->getShuffle();
+	}
+
+	return (word & kShuffle) ? 1 : 0;
+}
+
+/**
+ *
+ */
+void MyRendererStatus::dump(const char* name)
+{
+	ML_LOG_DEBUG("%s renderer status reads [%lu] from the renderer [%lu]\n", name, m_reads.load(), m_fallbacks.load());
+}
+
+/**
+ *
+ */
+void MyRendererStatus::store(uint32_t mask, uint32_t bits)
+{
+	uint32_t word = m_word.load(std::memory_order_relaxed);
+
+	while (!m_word.compare_exchange_weak(word, (word & ~mask) | bits, std::memory_order_release, std::memory_order_relaxed)) {
+		/* word was reloaded */
+	}
+}
+
+/**
+ * False if the bits in valid were never stored, counts the read.
+ */
+bool MyRendererStatus::load(uint32_t valid, uint32_t& word)
+{
+	word = m_word.load(std::memory_order_acquire);
+
+	m_reads.fetch_add(1, std::memory_order_relaxed);
+
+	if (!(word & valid)) {
+		m_fallbacks.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+class IRenderer;
+class SynchronizedStatus;
+enum class RendererState;
+
+/**
+ * Copy of the renderer status (SynchronizedStatus and transport state)
+ * packed into one atomic word, so handlers read it without a virtual
+ * call into the renderer and its locks. Updated from RendererChanges(),
+ * the state notifications and write through by the setters. Reads fall
+ * back to the renderer until a value was stored once.
+ */
+class MyRendererStatus
+{
+	public:
+		explicit MyRendererStatus(std::shared_ptr<IRenderer> renderer);
+
+		/**
+		 * Reads everything from the renderer once.
+		 */
+		void refresh();
+
+		/**
+		 * Reads the transport state from the renderer, returns it.
+		 */
+		RendererState refreshState();
+
+		void update(const SynchronizedStatus* status);
+		void setState(RendererState state);
+		void setRepeat(int repeat);
+		void setShuffle(int shuffle);
+		void setMute(int mute);
+
+		RendererState state();
+		int volume();
+		int mute();
+		int repeat();
+		int shuffle();
+
+		void dump(const char* name);
+
+	private:
+		enum {
+			kVolumeMask		= 0x000000FF,
+			kMute			= 0x00000100,
+			kRepeat			= 0x00000200,
+			kShuffle		= 0x00000400,
+			kStateShift		= 12,
+			kStateMask		= 0x0000F000,
+			kStatusValid	= 0x00010000,
+			kStateValid		= 0x00020000,
+		};
+
+		/**
+		 * Replaces the bits in mask by bits.
+		 */
+		void store(uint32_t mask, uint32_t bits);
+		bool load(uint32_t valid, uint32_t& word);
+
+	private:
+		std::shared_ptr<IRenderer> m_renderer;
+		std::atomic<uint32_t> m_word;
+		std::atomic<unsigned long> m_reads;
+		std::atomic<unsigned long> m_fallbacks;		/* read from the renderer, nothing stored yet */
+};
@@ -0,0 +1,161 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <algorithm>
+
+/* local includes */
+#include "MyScheduler.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MyScheduler& MyScheduler::instance()
+{
+	static MyScheduler s_scheduler;
+
+	return s_scheduler;
+}
+
+/**
+ *
+ */
+MyScheduler::MyScheduler()
+	:
+	m_running(NULL),
+	m_stop(false),
+	m_thread(&MyScheduler::run, this)
+{
+
+}
+
+/**
+ *
+ */
+MyScheduler::~MyScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_cond.notify_all();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+/**
+ *
+ */
+void MyScheduler::schedule(const void* owner, int slot, std::chrono::milliseconds delay, Task task, bool restart)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto due = std::chrono::steady_clock::now() + delay;
+
+		auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+			return (e.owner == owner) && (e.slot == slot);
+		});
+
+		if (it != m_entries.end()) {
+			it->task = task;
+
+			if (restart) {
+				it->due = due;
+			}
+		}
+		else {
+			Entry entry = { owner, slot, due, task };
+
+			m_entries.push_back(entry);
+		}
+	}
+
+	m_cond.notify_all();
+}
+
+/**
+ *
+ */
+bool MyScheduler::cancel(const void* owner, int slot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+		return (e.owner == owner) && (e.slot == slot);
+	});
+
+	if (it == m_entries.end()) {
+		return false;
+	}
+
+	m_entries.erase(it);
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyScheduler::cancelAll(const void* owner)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+		return e.owner == owner;
+	}), m_entries.end());
+
+	/* a task cancelling its own owner must not wait for itself */
+	if (std::this_thread::get_id() != m_thread.get_id()) {
+		m_cond.wait(lock, [&] { return m_running != owner; });
+	}
+}
+
+/**
+ *
+ */
+void MyScheduler::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		m_cond.wait(lock, [this] { return m_stop || !m_entries.empty(); });
+
+		if (m_stop) {
+			break;
+		}
+
+		auto next = std::min_element(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+			return a.due < b.due;
+		});
+
+		if (next->due > std::chrono::steady_clock::now()) {
+			/* woken up early by schedule()/cancel(), look again */
+			m_cond.wait_until(lock, next->due);
+			continue;
+		}
+
+		Task task = next->task;
+		m_running = next->owner;
+		m_entries.erase(next);
+
+		lock.unlock();
+
+		task();
+
+		lock.lock();
+
+		m_running = NULL;
+		m_cond.notify_all();
+	}
+}
@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Single timer thread running deferred tasks, used to coalesce and
+ * debounce commands of control points. A task is identified by its
+ * owner and a slot, scheduling it again replaces the pending one.
+ */
+class MyScheduler
+{
+	public:
+		typedef std::function<void()> Task;
+
+		static MyScheduler& instance();
+
+		/**
+		 * Runs task after delay. A pending task of the same owner/slot
+		 * is replaced, restart selects if its due time is moved too
+		 * (debounce) or kept (throttle).
+		 */
+		void schedule(const void* owner, int slot, std::chrono::milliseconds delay, Task task, bool restart = true);
+
+		/**
+		 * Drops a pending task, returns false if there was none.
+		 */
+		bool cancel(const void* owner, int slot);
+
+		/**
+		 * Drops all pending tasks of owner and waits for a running one,
+		 * must be called before the owner goes away.
+		 */
+		void cancelAll(const void* owner);
+
+	private:
+		struct Entry {
+			const void* owner;
+			int slot;
+			std::chrono::steady_clock::time_point due;
+			Task task;
+		};
+
+		MyScheduler();
+		~MyScheduler();
+
+		MyScheduler(const MyScheduler&);
+		MyScheduler& operator=(const MyScheduler&);
+
+		void run();
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::vector<Entry> m_entries;	/* a handful, linear search is fine */
+		const void* m_running;			/* owner of the task running right now */
+		bool m_stop;
+		std::thread m_thread;
+};
@@ -0,0 +1,123 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <chrono>
+
+/* local includes */
+#include "MySeekDebouncer.h"
+#include "MyPLTController.h"
+#include "MyScheduler.h"
+#include "Renderer.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MySeekDebouncer::MySeekDebouncer(std::shared_ptr<IRenderer> renderer, IMyPLTController* controller, MyControllerMutex& controllerMutex)
+	:
+	m_renderer(renderer),
+	m_controller(controller),
+	m_controllerMutex(controllerMutex),
+	m_pending(false),
+	m_mode(0),
+	m_time(0),
+	m_issued(0),
+	m_executed(0),
+	m_dropped(0)
+{
+
+}
+
+/**
+ *
+ */
+MySeekDebouncer::~MySeekDebouncer()
+{
+	cancel();
+}
+
+/**
+ *
+ */
+void MySeekDebouncer::seek(int mode, int time)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::shared_ptr<MediaItem> track = m_controller->currentTrack();
+
+	m_issued++;
+
+	if (m_pending && (m_track.lock() == track) && (mode == 1)) {
+		/* relative on top of the pending one, absolute stays absolute */
+		m_time += time;
+	}
+	else {
+		m_mode = mode;
+		m_time = time;
+	}
+
+	m_pending = true;
+	m_track = track;
+
+	MyScheduler::instance().schedule(this, 0, std::chrono::milliseconds(SEEK_DEBOUNCE), [this] { execute(); });
+}
+
+/**
+ *
+ */
+void MySeekDebouncer::cancel()
+{
+	MyScheduler::instance().cancelAll(this);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_pending = false;
+}
+
+/**
+ *
+ */
+void MySeekDebouncer::dump(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ML_LOG_DEBUG("%s seeks issued [%lu] executed [%lu] dropped [%lu]\n", name, m_issued, m_executed, m_dropped);
+}
+
+/**
+ * Same lock order as seek(), controller first.
+ */
+void MySeekDebouncer::execute()
+{
+	MY_LOCK_GUARD(controllerLock, m_controllerMutex);
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_pending) {
+		return;
+	}
+
+	if (m_track.lock() != m_controller->currentTrack()) {
+		m_pending = false;
+		m_dropped++;
+		return;
+	}
+
+	if (m_renderer->getState() == RendererState::Buffering) {
+		MyScheduler::instance().schedule(this, 0, std::chrono::milliseconds(SEEK_RETRY), [this] { execute(); });
+		return;
+	}
+
+	m_pending = false;
+	m_executed++;
+
+	ML_LOG_DEBUG("seek [%s] to [%d] s\n", m_mode ? "relative" : "absolute", m_time);
+
+	m_renderer->seek(m_controller, m_mode, m_time);
+}
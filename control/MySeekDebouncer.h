@@ -0,0 +1,67 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <MyProfiledMutex.h>
+#include <MediaItem.h>
+
+#define SEEK_DEBOUNCE		150	/* ms without a further seek before it's executed	*/
+#define SEEK_RETRY			100	/* ms, retry while the renderer is buffering		*/
+
+class IRenderer;
+class IMyPLTController;
+
+/**
+ * Debounces seeks of control points scrubbing the progress bar:
+ * only the last target is executed, once no further seek came in
+ * for SEEK_DEBOUNCE and the stream isn't buffering anymore. A seek
+ * pending for a track which is no longer the current is dropped.
+ */
+class MySeekDebouncer
+{
+	public:
+		/**
+		 * seek() is called for controller with its mutex held.
+		 */
+		MySeekDebouncer(std::shared_ptr<IRenderer> renderer, IMyPLTController* controller, MyControllerMutex& controllerMutex);
+		~MySeekDebouncer();
+
+		/**
+		 * mode and time as IRenderer::seek() (0 absolute, 1 relative),
+		 * the lock of the controller must be held.
+		 */
+		void seek(int mode, int time);
+
+		/**
+		 * Drops a pending seek, waits for one being executed.
+		 */
+		void cancel();
+
+		void dump(const char* name);
+
+	private:
+		void execute();
+
+	private:
+		std::mutex m_mutex;
+		std::shared_ptr<IRenderer> m_renderer;
+		IMyPLTController* m_controller;
+		MyControllerMutex& m_controllerMutex;
+		bool m_pending;
+		int m_mode;
+		int m_time;
+		std::weak_ptr<MediaItem> m_track;	/* track the seek is meant for */
+		unsigned long m_issued;
+		unsigned long m_executed;
+		unsigned long m_dropped;			/* track changed meanwhile */
+};
@@ -0,0 +1,208 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <PltUtilities.h>
+/* local includes */
+#include "MySubscriptions.h"
+#include "MyLogger.h"
+
+/**
+ * Quirk profiles, first match wins, the last entry is the default.
+ */
+static const MyQuirkProfile s_quirkProfiles[] = {
+	{ "Kinsky",		"Kinsky",	kQuirkResendTrackURI | kQuirkVolumeChannel	},
+	{ "Kazoo",		"Kazoo",	0											},
+	{ "default",	"",			0											},
+};
+
+#define QUIRK_PROFILE_COUNT (sizeof(s_quirkProfiles) / sizeof(s_quirkProfiles[0]))
+
+/**
+ *
+ */
+MySubscriptions::MySubscriptions()
+	:
+	m_quirkApplied(QUIRK_PROFILE_COUNT, 0),
+	m_quirkSkipped(QUIRK_PROFILE_COUNT, 0)
+{
+
+}
+
+/**
+ *
+ */
+const MyQuirkProfile* MySubscriptions::profile(const NPT_HttpRequest& request)
+{
+	const NPT_String* userAgent = request.GetHeaders().GetHeaderValue("User-Agent");
+
+	for (size_t i = 0; i < QUIRK_PROFILE_COUNT - 1; i++) {
+		if (userAgent && (userAgent->Find(s_quirkProfiles[i].userAgent, 0, true) >= 0)) {
+			return &s_quirkProfiles[i];
+		}
+	}
+
+	return &s_quirkProfiles[QUIRK_PROFILE_COUNT - 1];
+}
+
+/**
+ *
+ */
+void MySubscriptions::update(const NPT_HttpRequest& request, const NPT_HttpResponse& response, const char* serviceType)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	NPT_String sid;
+	NPT_Int32 timeout = -1;
+
+	if (response.GetStatusCode() != 200) {
+		return;
+	}
+
+	if (request.GetMethod().Compare("UNSUBSCRIBE") == 0) {
+		if (NPT_SUCCEEDED(PLT_UPnPMessageHelper::GetSID(request, sid))) {
+			m_subscriptions.erase(sid.GetChars());
+		}
+
+		return;
+	}
+
+	if (request.GetMethod().Compare("SUBSCRIBE") != 0) {
+		return;
+	}
+
+	/* new subscriptions get the SID with the response, renewals send it */
+	if (NPT_FAILED(PLT_UPnPMessageHelper::GetSID(response, sid)) &&
+		NPT_FAILED(PLT_UPnPMessageHelper::GetSID(request, sid))) {
+		return;
+	}
+
+	PLT_UPnPMessageHelper::GetTimeOut(response, timeout);
+
+	Subscription& subscription = m_subscriptions[sid.GetChars()];
+
+	if (subscription.serviceType.empty()) {
+		/* renewals may come without User-Agent, keep the initial profile */
+		subscription.serviceType = serviceType;
+		subscription.profile = profile(request);
+
+		ML_LOG_DEBUG("new subscriber %s on %s with profile %s\n", sid.GetChars(), serviceType, subscription.profile->name);
+	}
+
+	/* negative is infinite */
+	subscription.expires = std::chrono::steady_clock::now() + std::chrono::seconds((timeout < 0) ? 24 * 3600 : timeout);
+}
+
+/**
+ *
+ */
+bool MySubscriptions::hasSubscribers(const char* serviceType)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	expire();
+
+	for (auto& i : m_subscriptions) {
+		if (i.second.serviceType == serviceType) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ *
+ */
+unsigned int MySubscriptions::quirks()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	unsigned int quirks = 0;
+
+	expire();
+
+	for (auto& i : m_subscriptions) {
+		quirks |= i.second.profile->quirks;
+	}
+
+	return quirks;
+}
+
+/**
+ *
+ */
+void MySubscriptions::countQuirk(bool applied)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	expire();
+
+	for (size_t i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+		bool subscribed = false;
+
+		for (auto& s : m_subscriptions) {
+			if (s.second.profile == &s_quirkProfiles[i]) {
+				subscribed = true;
+				break;
+			}
+		}
+
+		if (!subscribed) {
+			continue;
+		}
+
+		if (applied) {
+			m_quirkApplied[i]++;
+		}
+		else {
+			m_quirkSkipped[i]++;
+		}
+	}
+}
+
+/**
+ *
+ */
+void MySubscriptions::dump(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	expire();
+
+	for (size_t i = 0; i < QUIRK_PROFILE_COUNT; i++) {
+		int count = 0;
+
+		for (auto& s : m_subscriptions) {
+			if (s.second.profile == &s_quirkProfiles[i]) {
+				count++;
+			}
+		}
+
+		ML_LOG_DEBUG("%s profile %s subscriptions [%d] state updates with quirk toggles [%lu] without [%lu]\n",
+					 name, s_quirkProfiles[i].name, count, m_quirkApplied[i], m_quirkSkipped[i]);
+	}
+}
+
+/**
+ * Drops subscriptions the CP didn't renew. Lock must be held.
+ */
+void MySubscriptions::expire()
+{
+	auto now = std::chrono::steady_clock::now();
+
+	for (auto it = m_subscriptions.begin(); it != m_subscriptions.end();) {
+		if (it->second.expires < now) {
+			it = m_subscriptions.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
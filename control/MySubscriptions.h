@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+
+/**
+ * Workarounds only needed by some control points.
+ */
+enum {
+	kQuirkResendTrackURI	= 0x01,	/* re-send CurrentTrackURI with every TransportState (Kinsky)	*/
+	kQuirkVolumeChannel		= 0x02,	/* "channel" instead of "Channel" on Volume/Mute (Kinsky)		*/
+};
+
+/**
+ * Quirk profile, selected by the User-Agent of the subscriber.
+ */
+struct MyQuirkProfile
+{
+	const char* name;
+	const char* userAgent;		/* case insensitive sub string, "" matches all */
+	unsigned int quirks;
+};
+
+/**
+ * Keeps track of the GENA subscriptions of a device, which services
+ * have subscribers and which quirks they need.
+ */
+class MySubscriptions
+{
+	public:
+		MySubscriptions();
+
+		/**
+		 * Profile matching the User-Agent of the request, never NULL.
+		 */
+		static const MyQuirkProfile* profile(const NPT_HttpRequest& request);
+
+		/**
+		 * Tracks SUBSCRIBE, renewals and UNSUBSCRIBE after the SDK has handled them.
+		 */
+		void update(const NPT_HttpRequest& request, const NPT_HttpResponse& response, const char* serviceType);
+
+		/**
+		 * True if the service has at least one active subscriber.
+		 */
+		bool hasSubscribers(const char* serviceType);
+
+		/**
+		 * Quirks needed by the current subscribers.
+		 */
+		unsigned int quirks();
+
+		/**
+		 * Counts state updates with (applied) and without quirk toggles,
+		 * per profile of the current subscribers.
+		 */
+		void countQuirk(bool applied);
+
+		void dump(const char* name);
+
+	private:
+		struct Subscription {
+			std::string serviceType;
+			const MyQuirkProfile* profile;
+			std::chrono::steady_clock::time_point expires;
+		};
+
+		void expire();
+
+	private:
+		std::mutex m_mutex;
+		std::map<std::string, Subscription> m_subscriptions; /* by SID */
+		std::vector<unsigned long> m_quirkApplied;	/* by profile */
+		std::vector<unsigned long> m_quirkSkipped;
+};
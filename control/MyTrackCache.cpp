@@ -0,0 +1,450 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <functional>
+#include <vector>
+
+/* Platinum/Neptune UPnP SDK includes */
+#include <Neptune.h>
+/* local includes */
+#include "MyTrackCache.h"
+#include "MyLogger.h"
+
+#define TRACK_CACHE_TIMEOUT			10000		/* ms, connect and I/O						*/
+#define TRACK_CACHE_CHUNK			(64*1024)	/* bytes per read							*/
+#define TRACK_CACHE_SHARE			4			/* a track may take 1/4 of the cache at most	*/
+
+/**
+ *
+ */
+MyTrackCache& MyTrackCache::instance()
+{
+	static MyTrackCache s_cache;
+
+	return s_cache;
+}
+
+/**
+ *
+ */
+MyTrackCache::MyTrackCache()
+	:
+	m_bytesMax(0),
+	m_bytes(0),
+	m_hits(0),
+	m_misses(0),
+	m_fills(0),
+	m_revalidations(0),
+	m_evictions(0),
+	m_rejects(0),
+	m_bytesFetched(0),
+	m_stop(false),
+	m_thread(&MyTrackCache::run, this)
+{
+
+}
+
+/**
+ *
+ */
+MyTrackCache::~MyTrackCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+
+	m_cond.notify_one();
+
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+/**
+ *
+ */
+void MyTrackCache::configure(const std::string& dir, uint64_t bytesMax)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	evict(UINT64_MAX);
+
+	/* the link handed out last stays in the old dir, it goes with the next lookup() */
+	m_dir = dir;
+	m_bytesMax = dir.empty() ? 0 : bytesMax;
+	m_queue.clear();
+	m_queued.clear();
+	m_rejected.clear();
+	m_rejectedOrder.clear();
+
+	if (!m_bytesMax) {
+		return;
+	}
+
+	/* the index isn't persisted, files of an earlier run are unknown */
+	if (DIR* d = opendir(m_dir.c_str())) {
+		while (struct dirent* e = readdir(d)) {
+			std::string name = e->d_name;
+
+			if ((name.size() > 4) && ((name.compare(name.size() - 4, 4, ".trk") == 0) || (name.compare(name.size() - 4, 4, ".prt") == 0) ||
+				((name.compare(name.size() - 4, 4, ".ply") == 0) && ((m_dir + "/" + name) != m_handedOut)))) {
+				unlink((m_dir + "/" + name).c_str());
+			}
+		}
+
+		closedir(d);
+	}
+}
+
+/**
+ *
+ */
+void MyTrackCache::admit(const std::string& uri)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_bytesMax || uri.empty() || m_queued.count(uri) || m_rejected.count(uri)) {
+			return;
+		}
+
+		auto it = m_entries.find(uri);
+
+		if ((it != m_entries.end()) &&
+			(std::chrono::steady_clock::now() - it->second.validated < std::chrono::seconds(TRACK_CACHE_REVALIDATE))) {
+			return;
+		}
+
+		m_queued.insert(uri);
+		m_queue.push_back(uri);
+	}
+
+	m_cond.notify_one();
+}
+
+/**
+ * A lookup is a track change, the link handed out for the previous
+ * track isn't needed anymore. The renderer gets its own hard link of
+ * the cached file, eviction or a new version of the track can unlink
+ * the .trk at any time without pulling the file from under it.
+ */
+bool MyTrackCache::lookup(const std::string& uri, std::string& path)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_handedOut.empty()) {
+		unlink(m_handedOut.c_str());
+		m_handedOut.clear();
+	}
+
+	if (!m_bytesMax) {
+		return false;
+	}
+
+	auto it = m_entries.find(uri);
+
+	if (it == m_entries.end()) {
+		m_misses++;
+		return false;
+	}
+
+	std::string link = it->second.path.substr(0, it->second.path.size() - 4) + ".ply";
+
+	/* left over if the previous run ended while playing it */
+	unlink(link.c_str());
+
+	if (::link(it->second.path.c_str(), link.c_str()) != 0) {
+		m_misses++;
+		return false;
+	}
+
+	m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+	m_handedOut = link;
+	path = link;
+	m_hits++;
+
+	return true;
+}
+
+/**
+ *
+ */
+void MyTrackCache::dump()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	unsigned long lookups = m_hits + m_misses;
+
+	ML_LOG_DEBUG("track cache [%llu/%llu] bytes in [%zu] tracks, hit rate [%.1f%%] of [%lu], fills [%lu] not modified [%lu] evicted [%lu] too large [%lu], fetched [%llu] bytes\n",
+				 (unsigned long long)m_bytes, (unsigned long long)m_bytesMax, m_entries.size(),
+				 lookups ? 100.0 * m_hits / lookups : 0.0, lookups, m_fills, m_revalidations, m_evictions, m_rejects,
+				 (unsigned long long)m_bytesFetched);
+}
+
+/**
+ * Drops least recently used tracks until bytes more fit. Lock must be held.
+ */
+void MyTrackCache::evict(uint64_t bytes)
+{
+	while (!m_lru.empty() && ((bytes == UINT64_MAX) || (m_bytes + bytes > m_bytesMax))) {
+		auto it = m_entries.find(m_lru.back());
+
+		unlink(it->second.path.c_str());
+		m_bytes -= it->second.size;
+		m_entries.erase(it);
+		m_lru.pop_back();
+		m_evictions++;
+	}
+}
+
+/**
+ * Remembers a track too large for the cache. Lock must be held.
+ */
+void MyTrackCache::reject(const std::string& uri)
+{
+	if (!m_rejected.insert(uri).second) {
+		return;
+	}
+
+	m_rejectedOrder.push_back(uri);
+	m_rejects++;
+
+	while (m_rejectedOrder.size() > TRACK_CACHE_REJECTS) {
+		m_rejected.erase(m_rejectedOrder.front());
+		m_rejectedOrder.pop_front();
+	}
+}
+
+/**
+ *
+ */
+std::string MyTrackCache::pathOf(const std::string& uri)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "/%016llx.trk", (unsigned long long)std::hash<std::string>()(uri));
+
+	return m_dir + name;
+}
+
+/**
+ * Downloads uri to entry.path, conditional if entry has validators.
+ * notModified is set on 304, the file is kept then. tooLarge is set
+ * if the track exceeds its share, by Content-Length or while reading.
+ * gone is set on 404/410 only, other errors may be transient.
+ */
+bool MyTrackCache::fetch(const std::string& uri, Entry& entry, bool& notModified, bool& tooLarge, bool& gone)
+{
+	NPT_HttpClient client;
+	NPT_HttpRequest request(uri.c_str(), NPT_HTTP_METHOD_GET, NPT_HTTP_PROTOCOL_1_1);
+	NPT_HttpResponse* response = NULL;
+	NPT_InputStreamReference stream;
+	std::string part = entry.path.substr(0, entry.path.size() - 4) + ".prt";
+	uint64_t limit;
+	bool result = false;
+
+	notModified = false;
+	tooLarge = false;
+	gone = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		limit = m_bytesMax / TRACK_CACHE_SHARE;
+	}
+
+	if (!request.GetUrl().IsValid()) {
+		return false;
+	}
+
+	client.SetTimeouts(TRACK_CACHE_TIMEOUT, TRACK_CACHE_TIMEOUT, TRACK_CACHE_TIMEOUT);
+
+	if (!entry.etag.empty()) {
+		request.GetHeaders().SetHeader("If-None-Match", entry.etag.c_str());
+	}
+
+	if (!entry.lastModified.empty()) {
+		request.GetHeaders().SetHeader("If-Modified-Since", entry.lastModified.c_str());
+	}
+
+	if (NPT_FAILED(client.SendRequest(request, response)) || !response) {
+		return false;
+	}
+
+	if ((response->GetStatusCode() == 404) || (response->GetStatusCode() == 410)) {
+		gone = true;
+	}
+	else if (response->GetStatusCode() == 304) {
+		notModified = true;
+		result = true;
+	}
+	else if ((response->GetStatusCode() == 200) && response->GetEntity() &&
+			 (response->GetEntity()->GetContentLength() > (NPT_LargeSize)limit)) {
+		tooLarge = true;
+	}
+	else if ((response->GetStatusCode() == 200) && response->GetEntity() &&
+			 NPT_SUCCEEDED(response->GetEntity()->GetInputStream(stream)) && !stream.IsNull()) {
+		const NPT_String* etag = response->GetHeaders().GetHeaderValue("ETag");
+		const NPT_String* lastModified = response->GetHeaders().GetHeaderValue("Last-Modified");
+		std::vector<uint8_t> buffer(TRACK_CACHE_CHUNK);
+		FILE* file = fopen(part.c_str(), "wb");
+		uint64_t size = 0;
+
+		result = (file != NULL);
+
+		while (result) {
+			NPT_Size read = 0;
+			NPT_Result res = stream->Read(&buffer[0], buffer.size(), &read);
+
+			if (res == NPT_ERROR_EOS) {
+				break;
+			}
+
+			/* no Content-Length, found out while reading */
+			if ((size += read) > limit) {
+				tooLarge = true;
+				result = false;
+			}
+			else if (NPT_FAILED(res) || (fwrite(&buffer[0], 1, read, file) != read)) {
+				result = false;
+			}
+		}
+
+		if (file && (fclose(file) != 0)) {
+			result = false;
+		}
+
+		if (result && (rename(part.c_str(), entry.path.c_str()) == 0)) {
+			entry.size = size;
+			entry.etag = etag ? etag->GetChars() : "";
+			entry.lastModified = lastModified ? lastModified->GetChars() : "";
+		}
+		else {
+			unlink(part.c_str());
+			result = false;
+		}
+	}
+
+	delete response;
+
+	return result;
+}
+
+/**
+ *
+ */
+void MyTrackCache::run()
+{
+#if defined(__linux__)
+	/* only use otherwise idle CPU time */
+	struct sched_param param;
+	param.sched_priority = 0;
+	pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (;;) {
+		m_cond.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+		if (m_stop) {
+			break;
+		}
+
+		std::string uri = m_queue.front();
+		m_queue.pop_front();
+
+		Entry entry;
+		auto it = m_entries.find(uri);
+		bool cached = (it != m_entries.end());
+		bool notModified;
+		bool tooLarge;
+		bool gone;
+
+		if (cached) {
+			entry = it->second;
+		}
+		else {
+			entry.path = pathOf(uri);
+			entry.size = 0;
+		}
+
+		lock.unlock();
+
+		bool fetched = fetch(uri, entry, notModified, tooLarge, gone);
+
+		lock.lock();
+
+		m_queued.erase(uri);
+		it = m_entries.find(uri);
+
+		if (tooLarge && m_bytesMax) {
+			reject(uri);
+		}
+
+		/* reconfigured meanwhile, or the entry was evicted */
+		if (!m_bytesMax || (cached != (it != m_entries.end()))) {
+			if (fetched && !notModified) {
+				unlink(entry.path.c_str());
+			}
+
+			continue;
+		}
+
+		if (!fetched) {
+			/* a timeout or an unreachable server keeps the copy, it's retried with the next admit() */
+			if (cached && (gone || tooLarge)) {
+				/* the server doesn't serve it anymore, don't play a stale copy */
+				unlink(it->second.path.c_str());
+				m_bytes -= it->second.size;
+				m_lru.erase(it->second.lru);
+				m_entries.erase(it);
+			}
+
+			continue;
+		}
+
+		entry.validated = std::chrono::steady_clock::now();
+
+		if (notModified) {
+			it->second.validated = entry.validated;
+			m_revalidations++;
+			continue;
+		}
+
+		if (cached) {
+			m_bytes -= it->second.size;
+			m_lru.erase(it->second.lru);
+			m_entries.erase(it);
+		}
+
+		m_bytesFetched += entry.size;
+
+		evict(entry.size);
+
+		if (m_bytes + entry.size > m_bytesMax) {
+			unlink(entry.path.c_str());
+			continue;
+		}
+
+		m_lru.push_front(uri);
+		entry.lru = m_lru.begin();
+		m_entries[uri] = entry;
+		m_bytes += entry.size;
+		m_fills++;
+
+		ML_LOG_DEBUG("cached %s [%llu] bytes\n", uri.c_str(), (unsigned long long)entry.size);
+	}
+}
@@ -0,0 +1,107 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+#define TRACK_CACHE_REVALIDATE		600		/* s, conditional GET of a cached track at most this often */
+#define TRACK_CACHE_REJECTS			1024	/* oversize URIs remembered */
+
+/**
+ * Optional bounded on disk cache of tracks, for looping playlists
+ * (repeat) which otherwise download the same files every cycle.
+ * Tracks are admitted by the controller when they are about to be
+ * replayed, filled and revalidated (ETag/Last-Modified, 304) by a low
+ * priority thread and evicted LRU. The controller plays the cached
+ * file instead of the URI on a lookup() hit. Tracks larger than the
+ * share a track may take are remembered and not fetched again.
+ * Disabled until configure().
+ */
+class MyTrackCache
+{
+	public:
+		static MyTrackCache& instance();
+
+		/**
+		 * Cache directory and size, bytesMax 0 disables it. Drops what
+		 * an earlier run left in dir.
+		 */
+		void configure(const std::string& dir, uint64_t bytesMax);
+
+		/**
+		 * Queues uri for download, or for revalidation if cached and
+		 * older than TRACK_CACHE_REVALIDATE.
+		 */
+		void admit(const std::string& uri);
+
+		/**
+		 * Local file of uri if cached, counts hits and misses. Called
+		 * for every track played, the file stays valid until the next
+		 * call.
+		 */
+		bool lookup(const std::string& uri, std::string& path);
+
+		void dump();
+
+	private:
+		struct Entry {
+			std::string path;
+			uint64_t size;
+			std::string etag;
+			std::string lastModified;
+			std::chrono::steady_clock::time_point validated;
+			std::list<std::string>::iterator lru;
+		};
+
+		MyTrackCache();
+		~MyTrackCache();
+
+		MyTrackCache(const MyTrackCache&);
+		MyTrackCache& operator=(const MyTrackCache&);
+
+		void run();
+		bool fetch(const std::string& uri, Entry& entry, bool& notModified, bool& tooLarge, bool& gone);
+		void reject(const std::string& uri);
+		void evict(uint64_t bytes);
+		std::string pathOf(const std::string& uri);
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_cond;
+		std::string m_dir;
+		uint64_t m_bytesMax;
+		uint64_t m_bytes;
+		std::map<std::string, Entry> m_entries;	/* by URI */
+		std::list<std::string> m_lru;			/* most recently used first */
+		std::deque<std::string> m_queue;
+		std::set<std::string> m_queued;
+		std::string m_handedOut;					/* link given to the renderer by lookup() */
+		std::set<std::string> m_rejected;			/* too large for the cache */
+		std::deque<std::string> m_rejectedOrder;	/* oldest first, bounds m_rejected */
+		unsigned long m_hits;
+		unsigned long m_misses;
+		unsigned long m_fills;
+		unsigned long m_revalidations;		/* 304 answers */
+		unsigned long m_evictions;
+		unsigned long m_rejects;
+		uint64_t m_bytesFetched;
+		bool m_stop;
+		std::thread m_thread;
+};
@@ -32,7 +32,8 @@ MyUPnPRenderer::MyUPnPRenderer(std::shared_ptr<IRenderer> renderer, void* ctx, c
 	:
 	IMyPLTController(renderer),
     PLT_MediaRenderer(friendly_name, show_ip, uuid, port),
-	m_context(ctx)
+	m_context(ctx),
+	m_volumeChannel(false)
 {
 	ML_ENTRY_EXIT();
 
@@ -46,21 +47,14 @@ MyUPnPRenderer::~MyUPnPRenderer()
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	cancelDeferred();
 
-/* this are equale functions */
-#if 0
-	for (auto i : m_mediaItems) {
-		i.reset();
-	}
-#else
-	std::for_each(m_mediaItems.begin(), m_mediaItems.end(), [](std::shared_ptr<MediaItem> n){ n.reset();});
-#endif
+	MY_LOCK_GUARD(lock, m_mutex);
 
 	m_mediaItems.clear();
 
 	m_index = -1;
-	m_testTime = 0;
+	m_clock.reset();
 
 	m_renderer.reset();
 }
@@ -77,6 +71,9 @@ NPT_Result MyUPnPRenderer::SetupServices()
 
     NPT_CHECK(PLT_MediaRenderer::SetupServices());
 
+    /* later updated by RendererChanges() */
+    m_rendererStatus.refresh();
+
     /* update what we can play */
     NPT_CHECK_FATAL(FindServiceByType("urn:schemas-upnp-org:service:ConnectionManager:1", service));
     service->SetStateVariable("SinkProtocolInfo" , RESOURCE_PROTOCOL_INFO_VALUES);
@@ -86,27 +83,134 @@ NPT_Result MyUPnPRenderer::SetupServices()
 		/* pause automatic eventing, we change multiple state vars */
 		rct->PauseEventing(true);
 
+		/* WA for Kinsky Volume see ApplyVolumeChannel(), only done if such a CP subscribes */
+
+		rct->SetStateVariable("Volume", NPT_String::FromInteger(m_rendererStatus.volume()));
+		rct->SetStateVariable("Mute", NPT_String::FromInteger(m_rendererStatus.mute()));
+
+		/* resume automatic eventing */
+		rct->PauseEventing(false);
+    }
+
+    return NPT_SUCCESS;
+}
+
+/**
+ * Tracks the subscribers, so Kinsky workarounds are only done if needed.
+ */
+NPT_Result MyUPnPRenderer::ProcessHttpSubscriberRequest(NPT_HttpRequest& request,
+														const NPT_HttpRequestContext& context,
+														NPT_HttpResponse& response)
+{
+	ML_ENTRY_EXIT();
+
+	PLT_Service* service = NULL;
+	NPT_Result result;
+
+	if (NPT_FAILED(FindServiceByEventSubURL(request.GetUrl().ToRequestString(true), service, true))) {
+		return PLT_MediaRenderer::ProcessHttpSubscriberRequest(request, context, response);
+	}
+
+	/* must be in place before the initial event is sent */
+	if ((request.GetMethod().Compare("SUBSCRIBE") == 0) &&
+		(MySubscriptions::profile(request)->quirks & kQuirkVolumeChannel) &&
+		(service->GetServiceType().Compare("urn:schemas-upnp-org:service:RenderingControl:1") == 0)) {
+		ApplyVolumeChannel();
+	}
+
+	result = PLT_MediaRenderer::ProcessHttpSubscriberRequest(request, context, response);
+
+	m_subscriptions.update(request, response, service->GetServiceType());
+
+	return result;
+}
+
+/**
+ *
+ */
+NPT_Result MyUPnPRenderer::OnAction(PLT_ActionReference& action, const PLT_HttpRequestContext& context)
+{
+	ML_ENTRY_EXIT();
+
+	if (action->GetActionDesc().GetName().Compare("GetPositionInfo") == 0) {
+		MY_LOCK_GUARD(lock, m_mutex);
+		PLT_Service* avt = action->GetActionDesc().GetService();
+		NPT_String timeString = PLT_Didl::FormatTimeStamp((m_index != -1) ? m_clock.seconds() : 0);
+
+		/* position on demand, extrapolated by the play clock */
+		avt->PauseEventing(true);
+
+		/* time since start of the current track */
+		avt->SetStateVariable("RelativeTimePosition", timeString);
+
+		/* time since start of the media */
+		avt->SetStateVariable("AbsoluteTimePosition", timeString);
+
+		avt->PauseEventing(false);
+	}
+
+	return PLT_MediaRenderer::OnAction(action, context);
+}
+
 /**
  * WA for Kinsky Volume
  * Kinsky seams to want "channel" and not "Channel", but according
  * UPnP A/V "Channel" would be correct.
  * Tested with other CPs too.
  */
-#if 1
+void MyUPnPRenderer::ApplyVolumeChannel()
+{
+	ML_ENTRY_EXIT();
+
+	MY_LOCK_GUARD(lock, m_mutex);
+	PLT_Service* rct = NULL;
+
+	if (m_volumeChannel) {
+		return;
+	}
+
+	if (NPT_SUCCEEDED(FindServiceByType("urn:schemas-upnp-org:service:RenderingControl:1", rct))) {
+		/* pause automatic eventing, we change multiple state vars */
+		rct->PauseEventing(true);
+
 		rct->SetStateVariable("Mute", "2");
 		rct->SetStateVariableExtraAttribute("Mute", "channel", "Master");
 		rct->SetStateVariable("Volume", "999");
 		rct->SetStateVariableExtraAttribute("Volume", "channel", "Master");
-#endif
 
-		rct->SetStateVariable("Volume", NPT_String::FromInteger(m_renderer->getVolume()));
-		rct->SetStateVariable("Mute", NPT_String::FromInteger(m_renderer->getMute()));
+		rct->SetStateVariable("Volume", NPT_String::FromInteger(m_rendererStatus.volume()));
+		rct->SetStateVariable("Mute", NPT_String::FromInteger(m_rendererStatus.mute()));
 
 		/* resume automatic eventing */
 		rct->PauseEventing(false);
-    }
 
-    return NPT_SUCCESS;
+		m_volumeChannel = true;
+	}
+}
+
+/**
+ * WA for kinsky tracks not advanced
+ * this will force to re-send the CurrentTrackURI together
+ * with the changed TransportState. Kinsky rely on this :-(.
+ * Eventing must be paused by the caller.
+ */
+void MyUPnPRenderer::ResendTrackURI(PLT_Service* service)
+{
+    NPT_String currentTrackURI;
+
+	if (!(m_subscriptions.quirks() & kQuirkResendTrackURI)) {
+		m_subscriptions.countQuirk(false);
+		return;
+	}
+
+	service->GetStateVariableValue("CurrentTrackURI", currentTrackURI);
+
+	/* clear and set to activate changed flag */
+	service->SetStateVariable("CurrentTrackURI", !currentTrackURI.IsEmpty() ? "" : "Gugus");
+	service->SetStateVariable("CurrentTrackURI", currentTrackURI);
+	service->SetStateVariable("TransportState", "");
+
+	m_subscriptions.countQuirk(true);
 }
 
 /**
@@ -120,29 +224,20 @@ void MyUPnPRenderer::UpdateState()
 
 	PLT_Service* service = NULL;
     NPT_String timeString;
-    NPT_String currentTrackURI;
-    NPT_String transportState;
+
+	RendererState state = m_rendererStatus.refreshState();
+
+	m_clock.setRunning(state == RendererState::Playing);
 
     /* update A/V transport stuff */
     if (NPT_SUCCEEDED(FindServiceByType("urn:schemas-upnp-org:service:AVTransport:1", service))) {
     	/* pause automatic eventing, we change multiple state vars */
     	service->PauseEventing(true);
 
-/* WA for kinsky tracks not advanced */
-#if 1
-		/**
-		 * this will force to re-send the CurrentTrackURI together
-		 * with the changed TransportState. Kinsky rely on this :-(.
-		 */
-    	service->GetStateVariableValue("CurrentTrackURI", currentTrackURI);
-
-		/* clear and set to activate changed flag */
-    	service->SetStateVariable("CurrentTrackURI", !currentTrackURI.IsEmpty() ? "" : "Gugus");
-    	service->SetStateVariable("CurrentTrackURI", currentTrackURI);
-    	service->SetStateVariable("TransportState", "");
-#endif
+		/* WA for kinsky tracks not advanced */
+		ResendTrackURI(service);
 
-		switch (m_renderer->getState()) {
+		switch (state) {
 			case RendererState::Stopped:
 				service->SetStateVariable("TransportState", (m_index != -1) ? "STOPPED" : "NO_MEDIA_PRESENT");
 
@@ -201,16 +296,18 @@ NPT_Result MyUPnPRenderer::OnPause(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String instanceID;
 
 	NPT_CHECK_SEVERE(action->GetArgumentValue("InstanceID", instanceID));
 	ML_LOG_DEBUG("OnPause InstanceID  %s\n", instanceID.GetChars());
 
-	if (m_renderer->getState() == RendererState::Playing) {
+	RendererState state = m_rendererStatus.state();
+
+	if (state == RendererState::Playing) {
 		m_renderer->pause(this);
 	}
-	else if (m_renderer->getState() == RendererState::Paused) {
+	else if (state == RendererState::Paused) {
 		m_renderer->unpause(this);
 	}
 
@@ -226,7 +323,7 @@ NPT_Result MyUPnPRenderer::OnPlay(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 	
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_Result result = NPT_SUCCESS;
 	NPT_String instanceID;
 	NPT_String speed;
@@ -240,12 +337,12 @@ NPT_Result MyUPnPRenderer::OnPlay(PLT_ActionReference& action)
 	ML_LOG_DEBUG("OnPlay m_index %d\n", m_index);
 
 	if (m_index != -1) {
-		if (m_renderer->getState() == RendererState::Paused) {
+		if (m_rendererStatus.state() == RendererState::Paused) {
 			m_renderer->unpause(this);
 		}
 		else {
 			std::shared_ptr<MediaItem> item = m_mediaItems[m_index];
-			m_renderer->play(this, item);
+			m_renderer->play(this, cachedItem(item));
 		}
 	}
 	else {
@@ -277,7 +374,7 @@ NPT_Result MyUPnPRenderer::OnStop(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String instanceID;
 
 	NPT_CHECK_SEVERE(action->GetArgumentValue("InstanceID", instanceID));
@@ -286,7 +383,7 @@ NPT_Result MyUPnPRenderer::OnStop(PLT_ActionReference& action)
 	/* if playint/pause -> stop */
 	m_renderer->stop(this);
 
-	m_testTime = 0;
+	m_clock.reset();
 
 	UpdateState();
 
@@ -300,13 +397,15 @@ NPT_Result MyUPnPRenderer::OnSetAVTransportURI(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 	
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
     NPT_Result result = NPT_SUCCESS;    
     PLT_Service* avt = NULL;
     NPT_String timeString;
     NPT_String currentURI; 				/* DLNA URI (from CurrentURI)					*/
 	NPT_String currentURIMetaData;		/* DLNA meta data (from CurrentURIMetaData)		*/
 	NPT_String instanceID;
+	PLT_MediaObjectListReference list;
+	PLT_MediaObject* object = NULL;
 
 	NPT_CHECK_SEVERE(action->GetArgumentValue("InstanceID", instanceID));
 	ML_LOG_DEBUG("OnSetAVTransportURI InstanceID  %s\n", instanceID.GetChars());
@@ -317,6 +416,21 @@ NPT_Result MyUPnPRenderer::OnSetAVTransportURI(PLT_ActionReference& action)
 	NPT_CHECK_SEVERE(action->GetArgumentValue("CurrentURIMetaData", currentURIMetaData));
 	ML_LOG_DEBUG("OnSetAVTransportURI CurrentURIMetaData  %s\n", currentURIMetaData.GetChars());
 
+	if (!currentURIMetaData.IsEmpty()) {
+	    if (NPT_SUCCEEDED(PLT_Didl::FromDidl(currentURIMetaData, list))) {
+	    	ML_LOG_DEBUG("object list count [%d]\n", list->GetItemCount());
+
+			/* get the first object of the list */
+			list->Get(0, object);
+	    }
+	}
+
+	/* best resource first, refuse tracks we can't decode before the current one is dropped */
+	if (object && !selectResources(object)) {
+		action->SetError(714, "Illegal MIME-type");
+		return NPT_FAILURE;
+	}
+
 	/**
 	 * if URI is empty, we have clear the playlist on CP
 	 * so stop the renderer
@@ -325,54 +439,33 @@ NPT_Result MyUPnPRenderer::OnSetAVTransportURI(PLT_ActionReference& action)
 		m_renderer->stop(this);
 	}
 
-	m_testTime = 0;
+	m_clock.reset();
 
 	/* clear all media items */
-/* this are equale functions */
-#if 0
-	for (auto i : m_mediaItems) {
-		i.reset();
-	}
-#else
-	std::for_each(m_mediaItems.begin(), m_mediaItems.end(), [](std::shared_ptr<MediaItem> n){ n.reset();});
-#endif
-
-	m_mediaItems.clear();
+	clearMediaItems();
 	m_index = -1;
-	m_testTime = 0;
+	m_clock.reset();
 
 	std::shared_ptr<MediaItem> mediaItem = nullptr;
 
 	if (!currentURI.IsEmpty()) {
-		mediaItem = std::make_shared<MediaItem>();
+		mediaItem = createMediaItem();
 
 		mediaItem->origin = kMediaItemOriginUPnP;
 		mediaItem->uri = currentURI.GetChars();
 	}
 
-	if (!currentURIMetaData.IsEmpty()) {
-	    PLT_MediaObjectListReference list;
-	    PLT_MediaObject* object = NULL;
-
-	    if (NPT_SUCCEEDED(PLT_Didl::FromDidl(currentURIMetaData, list))) {
-	    	ML_LOG_DEBUG("object list count [%d]\n", list->GetItemCount());
+	if (object) {
+		std::shared_ptr<MetaData> metaData = create_metadata_from_media_object(object);
 
-			/* get the first object of the list */
-			list->Get(0, object);
-
-			if (object) {
-				std::shared_ptr<MetaData> metaData = create_metadata_from_media_object(object);
-
-				if (metaData) {
-					if (!mediaItem) {
-						/* no URI ??? */
-						mediaItem = std::make_shared<MediaItem>();
-					}
-
-					upnp_update_playlist_from_metadata(mediaItem, metaData);
-				}
+		if (metaData) {
+			if (!mediaItem) {
+				/* no URI ??? */
+				mediaItem = createMediaItem();
 			}
-	    }
+
+			upnp_update_playlist_from_metadata(mediaItem, metaData);
+		}
 	}
 
 
@@ -389,6 +482,9 @@ NPT_Result MyUPnPRenderer::OnSetAVTransportURI(PLT_ActionReference& action)
  		avt->SetStateVariable("CurrentMediaDuration", timeString);
 
 		if (mediaItem) {
+			/* no duration in the meta data, a probed one may be known already */
+			probeDuration(mediaItem);
+
 			m_mediaItems.push_back(mediaItem);
 
 			m_index = 0;
@@ -398,7 +494,7 @@ NPT_Result MyUPnPRenderer::OnSetAVTransportURI(PLT_ActionReference& action)
 			avt->SetStateVariable("AVTransportURI", currentURI);
 			avt->SetStateVariable("CurrentTrackURI",currentURI);
 			avt->SetStateVariable("AVTransportURIMetaData", currentURIMetaData);
-			avt->SetStateVariable("CurrentTrackMetadata", currentURIMetaData);
+			avt->SetStateVariable("CurrentTrackMetadata", m_didlReducer.reduce(currentURIMetaData.GetChars()));
 
 			if (mediaItem->duration != 0) {
 				timeString = PLT_Didl::FormatTimeStamp(mediaItem->duration);
@@ -435,7 +531,6 @@ NPT_Result MyUPnPRenderer::OnSetVolume(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
 	NPT_String instanceID;
 	NPT_String channel;
 	NPT_String desiredVolume;
@@ -467,7 +562,8 @@ NPT_Result MyUPnPRenderer::OnSetVolume(PLT_ActionReference& action)
     	return NPT_FAILURE;
     }
 
-	m_renderer->setVolume(this, volume);
+	/* coalesced, the renderer gets it on the scheduler thread */
+	m_volume.set(volume);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -504,7 +600,7 @@ NPT_Result MyUPnPRenderer::OnSetMute(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String instanceID;
 	NPT_String channel;
 	NPT_String desiredMute;
@@ -538,6 +634,7 @@ NPT_Result MyUPnPRenderer::OnSetMute(PLT_ActionReference& action)
 		}
 
 		m_renderer->setMute(this, mute);
+		m_rendererStatus.setMute(mute);
 
 /* not needed, updated via RendererChanges */
 #if 0
@@ -562,7 +659,7 @@ NPT_Result MyUPnPRenderer::OnSeek(PLT_ActionReference& action)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String instanceID;
 	NPT_String unit;
 	NPT_String target;
@@ -595,7 +692,8 @@ NPT_Result MyUPnPRenderer::OnSeek(PLT_ActionReference& action)
 
 	ML_LOG_DEBUG("seek to [%u] seconds\n", time);
 
-	m_renderer->seek(this, 0, time);
+	/* debounced, CPs send a seek for every step while scrubbing */
+	m_seek.seek(0, time);
 
 	return NPT_SUCCESS;
 }
@@ -609,6 +707,8 @@ void MyUPnPRenderer::RendererChanges(SynchronizedStatus* status)
 
 	PLT_Service* service = NULL;
 
+	m_rendererStatus.update(status);
+
     /* setup mute and value with current values so that any CP sees the current values */
     if (NPT_SUCCEEDED(FindServiceByType("urn:schemas-upnp-org:service:RenderingControl:1", service))) {
 		/* pause automatic eventing, we change multiple state vars */
@@ -638,29 +738,20 @@ void MyUPnPRenderer::OnMsgPlayNext(MyMessage* arg)
 	 * for iterate to the next track we need to fake the TransportState to STOPPED
 	 * but we do not like to call real playStop in that case.
 	 */
+	MY_LOCK_GUARD(lock, m_mutex);
 	PLT_Service* service = NULL;
     NPT_String timeString;
-    NPT_String currentTrackURI;
-    NPT_String transportState;
+
+	/* the faked STOPPED has position 0, GetPositionInfo must agree */
+	m_clock.reset();
 
     /* update A/V transport stuff */
     if (NPT_SUCCEEDED(FindServiceByType("urn:schemas-upnp-org:service:AVTransport:1", service))) {
     	/* pause automatic eventing, we change multiple state vars */
     	service->PauseEventing(true);
 
-/* WA for kinsky tracks not advanced */
-#if 1
-		/**
-		 * this will force to re-send the CurrentTrackURI together
-		 * with the changed TransportState. Kinsky rely on this :-(.
-		 */
-    	service->GetStateVariableValue("CurrentTrackURI", currentTrackURI);
-
-		/* clear and set to activate changed flag */
-    	service->SetStateVariable("CurrentTrackURI", !currentTrackURI.IsEmpty() ? "" : "Gugus");
-    	service->SetStateVariable("CurrentTrackURI", currentTrackURI);
-    	service->SetStateVariable("TransportState", "");
-#endif
+		/* WA for kinsky tracks not advanced */
+		ResendTrackURI(service);
 
     	service->SetStateVariable("TransportState", (m_index != -1) ? "STOPPED" : "NO_MEDIA_PRESENT");
 
@@ -688,31 +779,25 @@ void MyUPnPRenderer::OnMsgUpdatePlayTime(MyMessage* arg)
 {
 	ML_ENTRY_EXIT();
 
-	std::lock_guard<std::mutex> lock(m_mutex);
+	MY_LOCK_GUARD(lock, m_mutex);
 	NPT_String timeString;
 	PLT_Service* avt = NULL;
 	UpdatePlayTimeMessage* msg = (UpdatePlayTimeMessage*)arg;
 
-	m_testTime = msg->getTime();
+	/**
+	 * ticks only correct the drift of the play clock, nothing to do while paused/stopped,
+	 * RelativeTimePosition/AbsoluteTimePosition aren't evented and set in GetPositionInfo
+	 */
+	if (!m_clock.correct(msg->getTime())) {
+		return;
+	}
 
 	if (NPT_SUCCEEDED(FindServiceByType("urn:schemas-upnp-org:service:AVTransport:1", avt))) {
 		avt->PauseEventing(true);
 
 		if (m_index != -1) {
-			timeString = PLT_Didl::FormatTimeStamp(m_testTime);
-
-			ML_LOG_DEBUG("RelativeTimePosition/AbsoluteTimePosition [%s]\n", timeString.GetChars());
-
-	 		/* time since start of the current track */
-			avt->SetStateVariable("RelativeTimePosition", timeString);
-
-			/* time since start of the media */
-			avt->SetStateVariable("AbsoluteTimePosition", timeString);
-
 			/* we do not get always the duration from metadata (KAZOO issue) */
-			if (m_mediaItems[m_index]->duration == 0) {
-				m_mediaItems[m_index]->duration = msg->getDuration();
-
+			if (rendererDuration(m_mediaItems[m_index], msg->getDuration())) {
 	 			timeString = PLT_Didl::FormatTimeStamp(m_mediaItems[m_index]->duration);
 
 	 			ML_LOG_DEBUG("DMR set CurrentTrackDuration/CurrentMediaDuration to [%s]\n", timeString.GetChars());
@@ -737,8 +822,13 @@ void MyUPnPRenderer::MessageListener(MyMessage * arg)
 		ML_LOG_DEBUG(" got message %s\n", MessageIDs::toString(arg->getMessageID()));
 
 		switch(arg->getMessageID()) {
-			case MessageIDs::UpdateState:
+			case MessageIDs::UpdateState: {
+				/* transitions of the renderer itself (end of track, errors) start/stop the clock too */
+				MY_LOCK_GUARD(lock, m_mutex);
+
+				m_clock.setRunning(m_rendererStatus.refreshState() == RendererState::Playing);
 				break;
+			}
 			case MessageIDs::PlayNext:
 				OnMsgPlayNext(arg);
 				break;
@@ -59,8 +59,15 @@ class MyUPnPRenderer : public IMyPLTController, public PLT_MediaRenderer
 	
 		/* helper functions */
 		NPT_Result SetupServices();
+		virtual NPT_Result OnAction(PLT_ActionReference& action, const PLT_HttpRequestContext& context);
+
+		virtual NPT_Result ProcessHttpSubscriberRequest(NPT_HttpRequest& request,
+														const NPT_HttpRequestContext& context,
+														NPT_HttpResponse& response);
 
 		void UpdateState();
+		void ResendTrackURI(PLT_Service* service);
+		void ApplyVolumeChannel();
 
 		void OnMsgPlayNext(MyMessage* arg);
 		void OnMsgUpdatePlayTime(MyMessage* arg);
@@ -72,4 +79,5 @@ class MyUPnPRenderer : public IMyPLTController, public PLT_MediaRenderer
 
 	private:
 		void* m_context;
+		bool m_volumeChannel; /* Kinsky "channel" attribute applied */
 };
@@ -0,0 +1,203 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+
+/* local includes */
+#include "MyVolumeCoalescer.h"
+#include "MyScheduler.h"
+#include "Renderer.h"
+#include "MyLogger.h"
+
+/**
+ *
+ */
+MyVolumeCoalescer::MyVolumeCoalescer(std::shared_ptr<IRenderer> renderer, IMyPLTController* controller, MyControllerMutex& controllerMutex)
+	:
+	m_renderer(renderer),
+	m_controller(controller),
+	m_controllerMutex(controllerMutex),
+	m_pending(false),
+	m_scheduled(false),
+	m_target(0),
+	m_applied(0),
+	m_ramp(0),
+	m_commands(0),
+	m_applies(0)
+{
+
+}
+
+/**
+ *
+ */
+MyVolumeCoalescer::~MyVolumeCoalescer()
+{
+	cancel();
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::set(int volume)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_pending) {
+		m_applied = m_renderer->getVolume();
+	}
+
+	m_target = std::max(0, std::min(volume, 100));
+	m_pending = true;
+	m_commands++;
+
+	schedule();
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::add(int delta)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_pending) {
+		m_applied = m_renderer->getVolume();
+		m_target = m_applied;
+	}
+
+	m_target = std::max(0, std::min(m_target + delta, 100));
+	m_pending = true;
+	m_commands++;
+
+	schedule();
+}
+
+/**
+ *
+ */
+int MyVolumeCoalescer::volume()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	return m_pending ? m_target : m_renderer->getVolume();
+}
+
+/**
+ *
+ */
+bool MyVolumeCoalescer::pending(int& volume)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_pending) {
+		volume = m_target;
+	}
+
+	return m_pending;
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::setRamp(int step)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_ramp = std::max(0, step);
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::cancel()
+{
+	MyScheduler::instance().cancelAll(this);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_pending = false;
+	m_scheduled = false;
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::dump(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	ML_LOG_DEBUG("%s volume commands [%lu] applied [%lu]\n", name, m_commands, m_applies);
+}
+
+/**
+ * The first command of a burst is applied right away, the following
+ * ones at most every VOLUME_APPLY_INTERVAL. Lock must be held.
+ */
+void MyVolumeCoalescer::schedule()
+{
+	if (m_scheduled) {
+		return;
+	}
+
+	auto next = m_lastApply + std::chrono::milliseconds(VOLUME_APPLY_INTERVAL);
+	auto now = std::chrono::steady_clock::now();
+	auto delay = (next > now) ? std::chrono::duration_cast<std::chrono::milliseconds>(next - now) : std::chrono::milliseconds(0);
+
+	m_scheduled = true;
+
+	MyScheduler::instance().schedule(this, 0, delay, [this] { apply(); }, false);
+}
+
+/**
+ *
+ */
+void MyVolumeCoalescer::apply()
+{
+	int volume;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_scheduled = false;
+
+		if (!m_pending) {
+			return;
+		}
+
+		volume = m_target;
+
+		if (m_ramp && (abs(m_target - m_applied) > m_ramp)) {
+			volume = m_applied + ((m_target > m_applied) ? m_ramp : -m_ramp);
+		}
+
+		m_applied = volume;
+		m_lastApply = std::chrono::steady_clock::now();
+		m_applies++;
+
+		if (volume != m_target) {
+			/* ramping, next step */
+			schedule();
+		}
+	}
+
+	MY_LOCK_GUARD(lock, m_controllerMutex);
+
+	m_renderer->setVolume(m_controller, volume);
+
+	/* only done once the renderer has it, a command meanwhile builds on the target, not the old volume */
+	std::lock_guard<std::mutex> coalescerLock(m_mutex);
+
+	if (m_pending && !m_scheduled && (m_applied == m_target)) {
+		m_pending = false;
+	}
+}
@@ -0,0 +1,80 @@
+/**
+ * Copyright (C) Albis Technologies AG 2015-2016
+ * All Rights Reserved
+ * -OWNER-----------------------------------------------------------------------
+ * Author      : Michael Schenk
+ *
+ * -HISTORY---------------------------------------------------------------------
+ *
+ * -ISSUES---------------------------------------------------------------------_
+ */
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <MyProfiledMutex.h>
+
+#define VOLUME_APPLY_INTERVAL		50	/* ms, min. time between two setVolume() */
+
+class IRenderer;
+class IMyPLTController;
+
+/**
+ * Coalesces volume commands (rotary knobs send dozens per second):
+ * the commands only move a target, the renderer gets at most one
+ * setVolume() per VOLUME_APPLY_INTERVAL on the scheduler thread,
+ * optionally ramped in steps.
+ */
+class MyVolumeCoalescer
+{
+	public:
+		/**
+		 * setVolume() is called for controller with its mutex held.
+		 */
+		MyVolumeCoalescer(std::shared_ptr<IRenderer> renderer, IMyPLTController* controller, MyControllerMutex& controllerMutex);
+		~MyVolumeCoalescer();
+
+		void set(int volume);
+		void add(int delta);
+
+		/**
+		 * Target while commands are pending, the renderer volume otherwise.
+		 */
+		int volume();
+
+		/**
+		 * Target if commands are pending, doesn't ask the renderer.
+		 */
+		bool pending(int& volume);
+
+		/**
+		 * Max. change per setVolume(), 0 jumps to the target.
+		 */
+		void setRamp(int step);
+
+		/**
+		 * Drops pending commands, waits for one being applied.
+		 */
+		void cancel();
+
+		void dump(const char* name);
+
+	private:
+		void schedule();
+		void apply();
+
+	private:
+		std::mutex m_mutex;
+		std::shared_ptr<IRenderer> m_renderer;
+		IMyPLTController* m_controller;
+		MyControllerMutex& m_controllerMutex;
+		bool m_pending;
+		bool m_scheduled;
+		int m_target;
+		int m_applied;		/* last value handed to the renderer */
+		int m_ramp;
+		std::chrono::steady_clock::time_point m_lastApply;
+		unsigned long m_commands;
+		unsigned long m_applies;
+};